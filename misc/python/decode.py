@@ -23,17 +23,28 @@
 # ------------------------------------------------------------------------------------------
 
 
-from ast import literal_eval
-from copy import copy
+# 根据译码表生成两级的表驱动译码器
+# 第一级由opcode[6:2]索引，第二级由func3和func7的分类索引
+# 其它字段（rd，rs1，imm等）在同一个表项内按照匹配表逐条比较
+# 用法： python3 decode.py rv32_dec.toml dec_table.h
+
+from argparse import ArgumentParser
 from pprint import pprint
-from tomlkit.toml_file import TOMLFile
 from os import path
 from typing import Union
 from re import search
 
-def toml_parse(file_path:str) -> dict[str,Union[str,dict]]:
-    to_doc = TOMLFile(file_path).read()
-    return literal_eval(str(to_doc))
+try:
+    from tomllib import load as _toml_load
+    def toml_parse(file_path:str) -> dict[str,Union[str,dict]]:
+        with open(file_path,"rb") as f:
+            return _toml_load(f)
+except ImportError:
+    from ast import literal_eval
+    from tomlkit.toml_file import TOMLFile
+    def toml_parse(file_path:str) -> dict[str,Union[str,dict]]:
+        to_doc = TOMLFile(file_path).read()
+        return literal_eval(str(to_doc))
 
 
 class Field():
@@ -47,7 +58,7 @@ class Field():
     def __len_calc(self):
         self._len = 0
         for pos in self._bit_pos:
-            search_result = search("(\d+):(\d+)|(\d+)",pos)
+            search_result = search(r"(\d+):(\d+)|(\d+)",pos)
             if search_result is not None:
                 if (search_result.groups()[2] is None):
                     self._len += abs(int(search_result.groups()[0]) -
@@ -64,7 +75,7 @@ class Field():
         offset = 0
         self._mask_list:list[tuple[int,str]] = []
         for pos in self._bit_pos:
-            search_result = search("(\d+):(\d+)|(\d+)",pos)
+            search_result = search(r"(\d+):(\d+)|(\d+)",pos)
             if search_result is not None:
                 tmp_mask = ["0"] * 32
                 if (search_result.groups()[2] is None):
@@ -85,61 +96,96 @@ class Field():
             else:
                 raise Exception("Format Error! Cannot parse the information of the field")
 
-    def _get_c_code(self,op:str,op_len=32):
+    @property
+    def key(self):
+        return (tuple(self._bit_pos),self._offset)
+
+    # 字段包含inst[31]时，拼接的结果需要符号扩展
+    @property
+    def signed(self):
+        return any(int(m[1][0]) for m in self._mask_list)
+
+    # 字段在指令中是连续的一段时，返回(mask,lsb)，用于匹配
+    def range_mask(self):
+        if len(self._mask_list) != 1 or self._offset != 0:
+            raise Exception(f"Format Error! Field {self._name} cannot be used for matching")
+        mask = int(self._mask_list[0][1],2)
+        return mask, (mask & -mask).bit_length() - 1
+
+    def _get_c_expr(self,op:str):
         tmp_list = []
         for msk in self._mask_list:
             shift_offset = "".join(reversed(msk[1])).index("1")  - msk[0] - self._offset
-            if shift_offset >= 0:
+            if shift_offset > 0:
                 tmp_list.append(f"(({op} & 0b{msk[1]}) >> {shift_offset})")
+            elif shift_offset == 0:
+                tmp_list.append(f"({op} & 0b{msk[1]})")
             else:
                 tmp_list.append(f"(({op} & 0b{msk[1]}) << {abs(shift_offset)})")
-        express = " |\n           ".join(tmp_list)
-        return f"    {self._name}\n        = {express};"
+        return " |\n           ".join(tmp_list)
+
+    def _get_c_code(self,op:str,op_len=32):
+        return f"    {self._name}\n        = {self._get_c_expr(op)};"
+
+    # 拼接并且按需符号扩展后的立即数
+    def _get_c_imm(self,op:str):
+        express = self._get_c_expr(op)
+        width = self._len + self._offset
+        if not self.signed or width == 32:
+            return f"(int32_t)({express})"
+        return f"((int32_t)(({express}) << {32 - width}) >> {32 - width})"
 
     def __repr__(self) -> str:
         tmp_list = [f"[offset: {t[0]} - mask: {t[1]}]" for t in self._mask_list]
         return "\n".join(tmp_list)
 
+
+# 第二级表项的索引字段
+DEC_FIELDS = ("opcode","func3","func7")
+# 作为func7比较的字段位置
+FUNC7_POS  = ("31:25",)
+# 寄存器编号，不作为立即数
+REG_FIELDS = ("rd","rs1","rs2")
+
 # instruction uop
 class Op():
-    def __init__(self,name:str,encoding:dict,out_fields:list[str],input_fields:dict[str,Field]) -> None:
+    def __init__(self,name:str,encoding:dict,imm:Field,fields:dict[str,Field],const) -> None:
         self.name = name
-        self.fix_fields = list[encoding.keys()]
-        self.determine_code =  f"is_{self.name} = {self.dec_code(encoding)};"
-        self.dispatch_args = out_fields
-
-
-    def dec_code(self,encoding:dict,field_mask:list[str] = None):
-        tmp_list = []
+        self.inst_id = f"INST_{name.upper()}"
+        self.imm = imm
+        self.opcode = None
+        self.func3 = None
+        self.func7 = None
+        self.mask = 0   # opcode，func3和func7以外的字段
+        self.match = 0
         for key in encoding:
-            if field_mask is not None and key in field_mask:
-                continue
+            value = encoding[key]
+            if type(value) is str:
+                value = const(value)
+            if key == "opcode":
+                self.opcode = value
+            elif key == "func3":
+                self.func3 = value
+            elif key == "func7" or tuple(fields[key]._bit_pos) == FUNC7_POS:
+                self.func7 = value
             else:
-                tmp_list.append(f"({key} == {encoding[key]})")
-        return " && ".join(tmp_list)
-
-    def dispatch_code(self):
-        tmp_list = [f"{field} = {field}" for field in self.dispatch_args]
-        args_express = ",".join(tmp_list)
-        return f"{self.name}({args_express});"
-
-class DecTree():
-    def __init__(self,field_name:str,match_table:dict,fields:list[str]) -> None:
-        self.field_name = field_name
-        if "match" in match_table:
-            if type(match_table["match"]) is str:
-                match_express = match_table["match"]
-                self.cond = f"{self.field_name} == {match_express}"
-                for key in match_table:
-                    if key in fields:
-                        self.sub_nodes = [DecTree(key,match_table[key],fields)]
-
-class DecTreeRoot(DecTree):
-    pass
+                mask, lsb = fields[key].range_mask()
+                self.mask  |= mask
+                self.match |= (value << lsb) & mask
+        if self.opcode is None or (self.opcode & 0b11) != 0b11:
+            raise Exception(f"Error! {name} must have a 32-bit opcode")
+
+    # 约束越多的指令越优先匹配
+    @property
+    def priority(self):
+        return bin(self.mask).count("1")
+
+    def __repr__(self) -> str:
+        return f"{self.name}: opcode={self.opcode:#x} func3={self.func3} func7={self.func7} mask={self.mask:#x} match={self.match:#x}"
 
 # decoder
 class Decoder():
-    def __init__(self,table_path:str,ext_list:list[str]) -> None:
+    def __init__(self,table_path:str,ext_list:list[str] = None) -> None:
         if not path.isfile(table_path):
             raise Exception(f"Error! the argument: {table_path} is not a file path!")
 
@@ -147,10 +193,12 @@ class Decoder():
         self.__get_all_extentions(ext_list)
         self.__get_arch_info()
         self.__glb_field_table = {}
-        self.__flags :dict[str:list[Op]] = {}
         if "field" in self.__dec_table:
             for key in self.__dec_table["field"]:
                 self.__glb_field_table[key] = Field(key,self.__dec_table["field"][key])
+        # 没有立即数的指令，与I-type一致，保存inst[31:20]
+        self.__default_imm = Field("imm",["31:20"])
+        self.ops :list[Op] = []
 
     def __get_arch_info(self):
         self.__arch_name :str = self.__dec_table["ISA"]
@@ -165,9 +213,12 @@ class Decoder():
         return self.__arch_name
 
     def __get_all_extentions(self,ext_list):
+        all_ext = self.__dec_table.get("extensions",{})
+        if ext_list is None:
+            ext_list = list(all_ext.keys())
         tmp_list = []
         for ext in ext_list:
-            if ext in self.__dec_table:
+            if ext in all_ext:
                 tmp_list.append(ext)
 
         self.__ext_in_table = tuple(tmp_list)
@@ -181,15 +232,183 @@ class Decoder():
             raise Exception(f"Cannot find Constant: {const_name} in decode table")
         return self.__dec_table["CONST"][const_name]
 
-
-    def dec_table_parse(self,ext_name:str):
-        self.dec_tree = []
+    # 一组指令的立即数：out_field中除寄存器以外的字段，没有时使用组内的imm字段
+    def __group_imm(self,group:dict,fields:dict[str,Field]) -> Field:
+        offset = group.get("imm_offset",0)
+        names = [f for f in group.get("out_field",[]) if f not in REG_FIELDS]
+        if len(names) != 1:
+            names = ["imm"] if "imm" in group.get("field",{}) else []
+        if len(names) == 0:
+            return self.__default_imm
+        return Field(names[0],fields[names[0]]._bit_pos,offset)
+
+    def dec_table_parse(self):
+        self.ops = []
         for ext in self.ext_in_table:
-            group_dict = self.__dec_table[ext]
-
-
-
-
+            for group_name, group in self.__dec_table["extensions"][ext].items():
+                fields = dict(self.__glb_field_table)
+                for key, pos in group.get("field",{}).items():
+                    fields[key] = Field(key,pos)
+                imm = self.__group_imm(group,fields)
+                for op_name, encoding in group.get("op",{}).items():
+                    self.ops.append(Op(op_name,encoding,imm,fields,self._get_const))
+
+    # -------------------------- C code -----------------------------------
+    def gen_c_table(self) -> str:
+        # func7分类，0表示没有出现在译码表中的值
+        f7_list = sorted({op.func7 for op in self.ops if op.func7 is not None})
+        f7_num = 1
+        while f7_num < len(f7_list) + 1:
+            f7_num <<= 1
+        f7_cls = {v: i + 1 for i, v in enumerate(f7_list)}
+        sub_size = 8 * f7_num
+
+        # 每个opcode一张第二级表，每个表项是一组候选指令
+        op_rows :dict[int,list[list[Op]]] = {}
+        for op in self.ops:
+            row = op_rows.setdefault(op.opcode >> 2,[[] for _ in range(sub_size)])
+            for f3 in range(8):
+                if op.func3 is not None and op.func3 != f3:
+                    continue
+                for cls in range(f7_num):
+                    if op.func7 is not None and f7_cls[op.func7] != cls:
+                        continue
+                    row[f3 * f7_num + cls].append(op)
+        rows = sorted(op_rows.keys())
+
+        # 立即数的格式只由opcode和func3决定，可以和查表同时计算
+        imm_rows :dict[int,list[Field]] = {}
+        for r in rows:
+            fmt = [None] * 8
+            for f3 in range(8):
+                for op in [o for c in op_rows[r][f3 * f7_num:(f3 + 1) * f7_num] for o in c]:
+                    if fmt[f3] is not None and fmt[f3].key != op.imm.key:
+                        raise Exception(f"Error! {op.name}: the immediate must be determined by opcode and func3")
+                    fmt[f3] = op.imm
+            # 没有定义的func3只会译码为非法指令，立即数可以任意选择
+            used = [f for f in fmt if f is not None]
+            imm_rows[r] = [f if f is not None else used[-1] for f in fmt]
+
+        # 表项为InstID，或者DEC_MATCH | 匹配组的编号
+        match_grp :list[tuple[int,int,str]] = [] # (first, num, default)
+        match_tbl :list[Op] = []
+        grp_cache :dict[tuple,int] = {}
+        def cell(cands:list[Op]):
+            if len(cands) == 0:
+                return "INST_ILLEGAL"
+            cands = sorted(cands,key=lambda op: -op.priority)
+            default = [op for op in cands if op.mask == 0]
+            if len(default) > 1:
+                raise Exception(f"Error! Conflicting encodings: {default}")
+            if len(cands) == 1 and cands[0].mask == 0:
+                return cands[0].inst_id
+            key = tuple(op.name for op in cands)
+            if key not in grp_cache:
+                grp_cache[key] = len(match_grp)
+                match_grp.append((len(match_tbl),len(cands) - len(default),
+                                  default[0].inst_id if default else "INST_ILLEGAL"))
+                match_tbl.extend([op for op in cands if op.mask != 0])
+            return f"DEC_MATCH | {grp_cache[key]}"
+
+        row_cells = {r: [cell(c) for c in op_rows[r]] for r in rows}
+
+        def imm_comment(f:Field):
+            return f"{f._name} = inst[{','.join(f._bit_pos)}]" + (f" << {f._offset}" if f._offset else "")
+
+        lines = []
+        w = lines.append
+        w("// 由 misc/python/decode.py 根据 misc/rv32_dec.toml 生成，不要手动修改")
+        w("// 只能被predecode.c包含")
+        w("")
+        w("#ifndef __DEC_TABLE_H__")
+        w("    #define __DEC_TABLE_H__")
+        w("")
+        w("#include <stdint.h>")
+        w("#include \"predecode.h\"")
+        w("")
+        w(f"#define DEC_F7_NUM  {f7_num}    // func7的分类数")
+        w(f"#define DEC_MATCH   0x80 // 表项需要继续查匹配表，低位为匹配组的编号")
+        w("")
+        w("typedef struct dec_match_t")
+        w("{")
+        w("    uint32_t mask;")
+        w("    uint32_t match;")
+        w("    uint8_t  id;")
+        w("} DecMatch;")
+        w("")
+        w("typedef struct dec_match_grp_t")
+        w("{")
+        w("    uint8_t first;  // 在dec_match_tbl中的起始位置")
+        w("    uint8_t num;")
+        w("    uint8_t dflt;   // 都不匹配时的结果")
+        w("} DecMatchGrp;")
+        w("")
+        w("// 立即数的拼接，没有立即数的指令与I-type一致")
+        w("static inline int32_t dec_imm(uint32_t inst){")
+        if any(len({f.key for f in imm_rows[r]}) > 1 for r in rows):
+            w("    uint8_t func3 = (inst >> 12) & 0b111;")
+        w("    switch ((inst >> 2) & 0b11111)")
+        w("    {")
+        for r in rows:
+            fmt = imm_rows[r]
+            if all(f.key == self.__default_imm.key for f in fmt):
+                continue
+            w(f"    case 0b{r:05b}:")
+            uniq = []
+            for f in fmt:
+                if f.key not in [u.key for u in uniq]:
+                    uniq.append(f)
+            # 出现次数最多的格式放在最后，不需要判断func3
+            uniq.sort(key=lambda u: sum(f.key == u.key for f in fmt))
+            for f in uniq[:-1]:
+                bits = sum(1 << f3 for f3 in range(8) if fmt[f3].key == f.key)
+                w(f"        if ((0b{bits:08b} >> func3) & 1) // {imm_comment(f)}")
+                w(f"            return {f._get_c_imm('inst')};")
+            w(f"        return {uniq[-1]._get_c_imm('inst')}; // {imm_comment(uniq[-1])}")
+        w("    default:")
+        w(f"        return {self.__default_imm._get_c_imm('inst')};")
+        w("    }")
+        w("}")
+        w("")
+        w("// func7 -> 分类")
+        w("static const uint8_t dec_f7_tbl[128] = {")
+        for v in f7_list:
+            w(f"    [0b{v:07b}] = {f7_cls[v]},")
+        w("};")
+        w("")
+        w("// opcode[6:2] -> 第二级表的编号，0表示非法指令")
+        w("static const uint8_t dec_op_tbl[32] = {")
+        for i, r in enumerate(rows):
+            w(f"    [0b{r:05b}] = {i + 1},")
+        w("};")
+        w("")
+        w("// 第二级表，由 func3 * DEC_F7_NUM + func7分类 索引")
+        w(f"static const uint8_t dec_sub_tbl[{len(rows) + 1}][{sub_size}] = {{")
+        w("    { // 没有定义的opcode")
+        for f3 in range(8):
+            w("        " + ", ".join(["INST_ILLEGAL"] * f7_num) + ",")
+        w("    },")
+        for r in rows:
+            w(f"    {{ // opcode = 0b{r:05b}11")
+            cells = row_cells[r]
+            for f3 in range(8):
+                w("        " + ", ".join(cells[f3 * f7_num:(f3 + 1) * f7_num]) + ",")
+            w("    },")
+        w("};")
+        w("")
+        w("// 匹配表，同一组内约束越多的指令越靠前")
+        w(f"static const DecMatch dec_match_tbl[{max(len(match_tbl),1)}] = {{")
+        for op in match_tbl:
+            w(f"    {{0x{op.mask:08x}, 0x{op.match:08x}, {op.inst_id}}},")
+        w("};")
+        w("")
+        w(f"static const DecMatchGrp dec_match_grp[{max(len(match_grp),1)}] = {{")
+        for g in match_grp:
+            w(f"    {{{g[0]}, {g[1]}, {g[2]}}},")
+        w("};")
+        w("")
+        w("#endif //__DEC_TABLE_H__")
+        return "\n".join(lines) + "\n"
 
     # -------------------------- print info -----------------------------------
     def print_table(self) -> None:
@@ -207,17 +426,13 @@ class Decoder():
 
 
 if __name__ == "__main__":
-    decoder = Decoder("./misc/rv32-dec.toml",["I"])
-    decoder.print_table()
-    decoder.print_arch_info()
-    decoder.print_fields()
-
-    print(Field("shift_imm",["31:25"])._get_c_code("inst"))
-    print(Field("shamt",["24:20"])._get_c_code("inst"))
-    print(Field("branch_imm",["11:8","30:25","7","31"],1)._get_c_code("inst"))
-    print(Field("jal_imm",["30:21","20","19:12","31"],1)._get_c_code("inst"))
-    print(Field("str_imm",["11:7","31:25"])._get_c_code("inst"))
-    print(Field("li_imm",["31:12"],12)._get_c_code("inst"))
-    print(Field("succ",["23:20"])._get_c_code("inst"))
-    print(Field("pred",["27:24"])._get_c_code("inst"))
-    print(Field("fm",["31:28"])._get_c_code("inst"))
+    parser = ArgumentParser("Generate the table-driven decoder")
+    parser.add_argument("table",help="file path of the decode table")
+    parser.add_argument("output",help="file path of the generated C header")
+    parser.add_argument("-e","--ext",nargs="*",help="extensions to generate, all extensions by default")
+    args = parser.parse_args()
+
+    decoder = Decoder(args.table,args.ext)
+    decoder.dec_table_parse()
+    with open(args.output,"w") as f:
+        f.write(decoder.gen_c_table())
@@ -0,0 +1,655 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include <dlfcn.h>
+
+#include "aot.h"
+#include "predecode.h"
+#include "dec_cache.h"
+#include "jit_x64.h"
+#include "cpu_config.h"
+#include "../include/comm.h"
+
+#define AOT_MAX_SEG     16  // 可执行段的最大数量
+
+// ----------------------------------------------
+// 代码生成
+// ----------------------------------------------
+typedef struct aot_seg_t
+{
+    uint32_t base;          // 段的起始地址
+    uint32_t size;          // 文件中有内容的部分，bss不会包含代码
+    const uint8_t *data;
+    uint8_t *leader;        // 每条指令一个标记，1表示是基本块的起始地址
+} AotSeg;
+
+static AotSeg   seg[AOT_MAX_SEG];
+static uint32_t seg_num;
+static uint32_t *work;      // 待反汇编的基本块
+static uint32_t work_num;
+static uint32_t work_cap;
+
+static uint32_t hash_step(uint32_t h, uint32_t inst){
+    return (h ^ inst) * 16777619u; // FNV-1a
+}
+
+static AotSeg* seg_find(uint32_t addr){
+    for (uint32_t i = 0; i < seg_num; i++)
+    {
+        if (addr >= seg[i].base && (uint64_t)addr + 4 <= (uint64_t)seg[i].base + seg[i].size)
+            return &seg[i];
+    }
+    return NULL;
+}
+
+static int img_fetch(uint32_t addr, DecInst *d){
+    AotSeg *s = seg_find(addr);
+    uint32_t inst;
+    if (s == NULL)
+        return 0;
+    memcpy(&inst,s->data + (addr - s->base),4);
+    predecode(inst,d);
+    return 1;
+}
+
+// 将addr加入待反汇编的列表，不在可执行段中或者已经加入过时忽略
+static void work_add(uint32_t addr){
+    AotSeg *s;
+    if (MOD(addr,4) != 0 || (s = seg_find(addr)) == NULL)
+        return;
+    uint32_t idx = (addr - s->base) / 4;
+    if (s->leader[idx])
+        return;
+    s->leader[idx] = 1;
+    if (work_num == work_cap) {
+        work_cap = work_cap ? work_cap * 2 : 1024;
+        work = (uint32_t*)realloc(work,sizeof(uint32_t) * work_cap);
+    }
+    work[work_num++] = addr;
+}
+
+// 与blk_cache_get()相同的规则切分基本块，返回指令数
+static uint32_t scan_block(uint32_t pc, DecInst *dec){
+    uint32_t inst_num = 0;
+    uint32_t addr = pc;
+    while (inst_num < BLK_MAX_INST)
+    {
+        if (!img_fetch(addr,&dec[inst_num]))
+            break;
+        inst_num += 1;
+        addr += 4;
+        if (is_blk_end(dec[inst_num - 1].id) || MOD(addr,DEC_PAGE_SIZE) == 0)
+            break;
+    }
+    return inst_num;
+}
+
+// 收集基本块的后继
+// 除了分支和跳转的目标，还跟踪块内lui/auipc/addi产生的常量，
+// 作为jalr的目标，或者落在可执行段中的地址（函数指针，mtvec等）
+static void find_succ(uint32_t pc, const DecInst *dec, uint32_t inst_num){
+    uint8_t  known[32] = {1};
+    uint32_t val[32]   = {0};
+
+    for (uint32_t i = 0; i < inst_num; i++)
+    {
+        const DecInst *d = &dec[i];
+        uint32_t ipc = pc + 4 * i;
+        uint8_t set = 0;
+        uint32_t v = 0;
+        switch (d->id)
+        {
+        case INST_BEQ: case INST_BNE: case INST_BLT:
+        case INST_BGE: case INST_BLTU: case INST_BGEU:
+            work_add(ipc + (uint32_t)d->imm);
+            work_add(ipc + 4);
+            continue;
+        case INST_JAL:
+            work_add(ipc + (uint32_t)d->imm);
+            if (d->rd != 0)
+                work_add(ipc + 4);
+            break;
+        case INST_JALR:
+            if (known[d->rs1])
+                work_add((val[d->rs1] + (uint32_t)d->imm) & ~1u);
+            if (d->rd != 0)
+                work_add(ipc + 4);
+            break;
+        case INST_ECALL: case INST_EBREAK:
+        case INST_CSRRW: case INST_CSRRS: case INST_CSRRC:
+        case INST_CSRRWI:case INST_CSRRSI:case INST_CSRRCI:
+            // trap处理程序通常返回到下一条指令
+            work_add(ipc + 4);
+            break;
+        case INST_LUI:
+            set = 1;
+            v = (uint32_t)d->imm;
+            break;
+        case INST_AUIPC:
+            set = 1;
+            v = ipc + (uint32_t)d->imm;
+            break;
+        case INST_ADDI:
+            if (known[d->rs1]) {
+                set = 1;
+                v = val[d->rs1] + (uint32_t)d->imm;
+                work_add(v);
+            }
+            break;
+        case INST_SB: case INST_SH: case INST_SW:
+            continue;
+        default:
+            break;
+        }
+        if (d->rd != 0) {
+            known[d->rd] = set;
+            val[d->rd] = v;
+        }
+    }
+    // 因为长度或者页边界结束
+    if (inst_num > 0 && !is_blk_end(dec[inst_num - 1].id))
+        work_add(pc + 4 * inst_num);
+}
+
+static inline int misaligned(uint32_t target){
+    return (target & ((IALIGN == 32) ? 0b11 : 0b01)) > 0;
+}
+
+// 与JIT相同，SYSTEM指令，fence.i，非法指令和目标不对齐的跳转不翻译，由解释器执行
+static int can_gen(const DecInst *d, uint32_t pc){
+    switch (d->id)
+    {
+    case INST_NONE: case INST_ILLEGAL:
+    case INST_ECALL: case INST_EBREAK: case INST_MRET:
+    case INST_CSRRW: case INST_CSRRS: case INST_CSRRC:
+    case INST_CSRRWI:case INST_CSRRSI:case INST_CSRRCI:
+    case INST_FENCE_I:
+        return 0;
+    case INST_BEQ: case INST_BNE: case INST_BLT:
+    case INST_BGE: case INST_BLTU: case INST_BGEU:
+    case INST_JAL:
+        return !misaligned(pc + (uint32_t)d->imm);
+    default:
+        return 1;
+    }
+}
+
+static const char* alu_op(uint8_t id){
+    switch (id)
+    {
+    case INST_ADD: case INST_ADDI: return "+";
+    case INST_SUB:                 return "-";
+    case INST_XOR: case INST_XORI: return "^";
+    case INST_OR:  case INST_ORI:  return "|";
+    case INST_AND: case INST_ANDI: return "&";
+    case INST_MUL:                 return "*";
+    default:                       return NULL;
+    }
+}
+
+static const char* br_cond(uint8_t id){
+    switch (id)
+    {
+    case INST_BEQ:  return "x[%u] == x[%u]";
+    case INST_BNE:  return "x[%u] != x[%u]";
+    case INST_BLT:  return "(int32_t)x[%u] < (int32_t)x[%u]";
+    case INST_BGE:  return "(int32_t)x[%u] >= (int32_t)x[%u]";
+    case INST_BLTU: return "x[%u] < x[%u]";
+    default:        return "x[%u] >= x[%u]";
+    }
+}
+
+// 翻译一条指令，语义与jit_x64.c中的emit_inst()一致
+// retired为执行完该指令后的指令数
+// 返回1表示继续翻译下一条指令，返回2表示已经生成了返回语句
+static int gen_inst(FILE *fp, const DecInst *d, uint32_t pc, uint32_t retired){
+    uint8_t rd = d->rd, rs1 = d->rs1, rs2 = d->rs2;
+    uint32_t imm = (uint32_t)d->imm;
+    const char *name;
+
+    switch (d->id)
+    {
+    // OP_32
+    case INST_ADD: case INST_SUB: case INST_XOR: case INST_OR: case INST_AND:
+    case INST_MUL:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = x[%u] %s x[%u];\n",rd,rs1,alu_op(d->id),rs2);
+        return 1;
+    case INST_SLL: case INST_SRL:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = x[%u] %s (x[%u] & 31);\n",rd,rs1,d->id == INST_SLL ? "<<" : ">>",rs2);
+        return 1;
+    case INST_SRA:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = (uint32_t)((int32_t)x[%u] >> (x[%u] & 31));\n",rd,rs1,rs2);
+        return 1;
+    case INST_SLT:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = (int32_t)x[%u] < (int32_t)x[%u];\n",rd,rs1,rs2);
+        return 1;
+    case INST_SLTU:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = x[%u] < x[%u];\n",rd,rs1,rs2);
+        return 1;
+    // M extension
+    case INST_MULH:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = (uint32_t)((uint64_t)((int64_t)(int32_t)x[%u] * (int32_t)x[%u]) >> 32);\n",rd,rs1,rs2);
+        return 1;
+    case INST_MULHU:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = (uint32_t)(((uint64_t)x[%u] * x[%u]) >> 32);\n",rd,rs1,rs2);
+        return 1;
+    case INST_MULHSU:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = (uint32_t)((uint64_t)((int64_t)(int32_t)x[%u] * (int64_t)x[%u]) >> 32);\n",rd,rs1,rs2);
+        return 1;
+    case INST_DIV: case INST_DIVU: case INST_REM: case INST_REMU:
+    {
+        // 除数为0和溢出时与execution.h一致，即使rd为x0也会写入
+        uint8_t is_signed = (d->id == INST_DIV || d->id == INST_REM);
+        uint8_t is_rem    = (d->id == INST_REM || d->id == INST_REMU);
+        fprintf(fp,"    { uint32_t a = x[%u], b = x[%u];\n",rs1,rs2);
+        fprintf(fp,"      if (b == 0) x[%u] = %s;\n",rd,is_rem ? "a" : "0xffffffffu");
+        if (is_signed)
+            fprintf(fp,"      else if (b == 0xffffffffu && a == 0x80000000u) x[%u] = %s;\n",rd,is_rem ? "0" : "0x80000000u");
+        if (rd != 0) {
+            if (is_signed)
+                fprintf(fp,"      else x[%u] = (uint32_t)((int32_t)a %s (int32_t)b);\n",rd,is_rem ? "%" : "/");
+            else
+                fprintf(fp,"      else x[%u] = a %s b;\n",rd,is_rem ? "%" : "/");
+        }
+        fprintf(fp,"    }\n");
+        return 1;
+    }
+    // OP_IMM
+    case INST_ADDI: case INST_XORI: case INST_ORI: case INST_ANDI:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = x[%u] %s 0x%xu;\n",rd,rs1,alu_op(d->id),imm);
+        return 1;
+    case INST_SLTI:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = (int32_t)x[%u] < %d;\n",rd,rs1,d->imm);
+        return 1;
+    case INST_SLTIU:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = x[%u] < 0x%xu;\n",rd,rs1,imm);
+        return 1;
+    case INST_SLLI: case INST_SRLI:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = x[%u] %s %u;\n",rd,rs1,d->id == INST_SLLI ? "<<" : ">>",imm);
+        return 1;
+    case INST_SRAI:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = (uint32_t)((int32_t)x[%u] >> %u);\n",rd,rs1,imm);
+        return 1;
+    // load imme
+    case INST_LUI:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = 0x%xu;\n",rd,imm);
+        return 1;
+    case INST_AUIPC:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = 0x%xu;\n",rd,pc + imm);
+        return 1;
+    // MISC_MEM
+    case INST_NOP: case INST_WFI: case INST_FENCE: case INST_FENCE_TSO:
+    case INST_PAUSE:
+        return 1;
+    // LOAD
+    case INST_LB: case INST_LH: case INST_LW: case INST_LBU: case INST_LHU:
+        if (d->id == INST_LB)       name = "h_lb";
+        else if (d->id == INST_LH)  name = "h_lh";
+        else if (d->id == INST_LW)  name = "h_lw";
+        else if (d->id == INST_LBU) name = "h_lbu";
+        else                        name = "h_lhu";
+        // 访问出错时load不执行，返回到这条指令由解释器产生异常
+        fprintf(fp,"    { uint64_t v = %s(x[%u] + 0x%xu);\n",name,rs1,imm);
+        fprintf(fp,"      if (v >> 32) RET(0x%xu, %u);\n",pc,retired - 1);
+        if (rd != 0)
+            fprintf(fp,"      x[%u] = (uint32_t)v;\n",rd);
+        fprintf(fp,"    }\n");
+        return 1;
+    // STORE
+    case INST_SB: case INST_SH: case INST_SW:
+        if (d->id == INST_SB)       name = "h_sb";
+        else if (d->id == INST_SH)  name = "h_sh";
+        else                        name = "h_sw";
+        // 写到了已经翻译的代码，立即返回；访问出错时store不执行，由解释器产生异常
+        fprintf(fp,"    switch (%s(x[%u] + 0x%xu, x[%u])) {\n",name,rs1,imm,rs2);
+        fprintf(fp,"      case 1: RET(0x%xu, %u);\n",pc + 4,retired);
+        fprintf(fp,"      case 2: RET(0x%xu, %u);\n",pc,retired - 1);
+        fprintf(fp,"    }\n");
+        return 1;
+    // BRANCH
+    case INST_BEQ: case INST_BNE: case INST_BLT:
+    case INST_BGE: case INST_BLTU: case INST_BGEU:
+        fprintf(fp,"    if (");
+        fprintf(fp,br_cond(d->id),rs1,rs2);
+        fprintf(fp,") RET(0x%xu, XFER | %u);\n",pc + imm,retired);
+        fprintf(fp,"    RET(0x%xu, XFER | %u);\n",pc + 4,retired);
+        return 2;
+    // JUMP
+    case INST_JAL:
+        if (rd != 0)
+            fprintf(fp,"    x[%u] = 0x%xu;\n",rd,pc + 4);
+        fprintf(fp,"    RET(0x%xu, XFER | %u);\n",pc + imm,retired);
+        return 2;
+    case INST_JALR:
+        fprintf(fp,"    { uint32_t t = (x[%u] + 0x%xu) & ~1u;\n",rs1,imm);
+        // 不对齐的跳转地址，jalr不执行，由解释器产生异常
+        if (IALIGN == 32)
+            fprintf(fp,"      if (t & 2) RET(0x%xu, %u);\n",pc,retired - 1);
+        if (rd != 0)
+            fprintf(fp,"      x[%u] = 0x%xu;\n",rd,pc + 4);
+        fprintf(fp,"      RET(t, XFER | %u); }\n",retired);
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static const char aot_prologue[] =
+    "#include <stdint.h>\n"
+    "\n"
+    "typedef struct { uint64_t next_pc; uint64_t retired; } AotRet;\n"
+    "typedef struct { uint32_t pc; uint32_t inst_num; uint32_t hash; void *func; } AotEntry;\n"
+    "\n"
+    "#define XFER 0x80000000u\n"
+    "#define RET(p, n) return (AotRet){(p), (n)}\n"
+    "\n"
+    "static uint64_t (*h_lb)(uint32_t);\n"
+    "static uint64_t (*h_lh)(uint32_t);\n"
+    "static uint64_t (*h_lw)(uint32_t);\n"
+    "static uint64_t (*h_lbu)(uint32_t);\n"
+    "static uint64_t (*h_lhu)(uint32_t);\n"
+    "static int (*h_sb)(uint32_t, uint32_t);\n"
+    "static int (*h_sh)(uint32_t, uint32_t);\n"
+    "static int (*h_sw)(uint32_t, uint32_t);\n"
+    "\n"
+    "void aot_bind(void *const *h)\n"
+    "{\n"
+    "    h_lb  = (uint64_t (*)(uint32_t))h[0];\n"
+    "    h_lh  = (uint64_t (*)(uint32_t))h[1];\n"
+    "    h_lw  = (uint64_t (*)(uint32_t))h[2];\n"
+    "    h_lbu = (uint64_t (*)(uint32_t))h[3];\n"
+    "    h_lhu = (uint64_t (*)(uint32_t))h[4];\n"
+    "    h_sb  = (int (*)(uint32_t, uint32_t))h[5];\n"
+    "    h_sh  = (int (*)(uint32_t, uint32_t))h[6];\n"
+    "    h_sw  = (int (*)(uint32_t, uint32_t))h[7];\n"
+    "}\n"
+    "\n";
+
+static void img_free(uint8_t *buf){
+    for (uint32_t i = 0; i < seg_num; i++)
+        free(seg[i].leader);
+    seg_num = 0;
+    free(work);
+    work = NULL;
+    work_num = 0;
+    work_cap = 0;
+    free(buf);
+}
+
+int aot_gen(const char *elf_file, const char *out_file)
+{
+#ifdef RV64
+    printf("Error! AOT only supports RV32\n");
+    return 1;
+#endif
+    FILE *fp = fopen(elf_file,"rb");
+    if (fp == NULL) {
+        printf("Cannot open file: %s\n",elf_file);
+        return 1;
+    }
+    fseek(fp,0,SEEK_END);
+    long elf_size = ftell(fp);
+    fseek(fp,0,SEEK_SET);
+    uint8_t *buf = (uint8_t*)malloc((size_t)elf_size);
+    if (buf == NULL || elf_size < (long)sizeof(Elf32_Ehdr) ||
+        fread(buf,1,(size_t)elf_size,fp) != (size_t)elf_size) {
+        printf("Error! Cannot read ELF file: %s\n",elf_file);
+        fclose(fp);
+        free(buf);
+        return 1;
+    }
+    fclose(fp);
+
+    Elf32_Ehdr *h = (Elf32_Ehdr*)buf;
+    if (memcmp(h->e_ident,ELFMAG,SELFMAG) != 0 || h->e_ident[EI_CLASS] != ELFCLASS32 ||
+        h->e_type != ET_EXEC || h->e_machine != EM_RISCV ||
+        (uint64_t)h->e_phoff + (uint64_t)h->e_phnum * sizeof(Elf32_Phdr) > (uint64_t)elf_size) {
+        printf("Error! Not a RV32 executable file: %s\n",elf_file);
+        free(buf);
+        return 1;
+    }
+
+    // 收集可执行段
+    Elf32_Phdr *pht = (Elf32_Phdr*)(buf + h->e_phoff);
+    seg_num = 0;
+    for (uint32_t i = 0; i < h->e_phnum && seg_num < AOT_MAX_SEG; i++)
+    {
+        Elf32_Phdr *p = &pht[i];
+        if (p->p_type != PT_LOAD || (p->p_flags & PF_X) == 0 ||
+            (uint64_t)p->p_offset + p->p_filesz > (uint64_t)elf_size)
+            continue;
+        seg[seg_num].base = p->p_vaddr;
+        seg[seg_num].size = p->p_filesz;
+        seg[seg_num].data = buf + p->p_offset;
+        seg[seg_num].leader = (uint8_t*)calloc(p->p_filesz / 4 + 1,1);
+        seg_num += 1;
+    }
+
+    // 从入口开始递归反汇编
+    DecInst dec[BLK_MAX_INST];
+    uint32_t blk_num = 0;
+    work_add(h->e_entry);
+    while (work_num > 0)
+    {
+        uint32_t pc = work[--work_num];
+        uint32_t inst_num = scan_block(pc,dec);
+        find_succ(pc,dec,inst_num);
+        blk_num += 1;
+    }
+
+    fp = fopen(out_file,"w");
+    if (fp == NULL) {
+        printf("Error! Cannot open output file: %s\n",out_file);
+        img_free(buf);
+        return 1;
+    }
+    fprintf(fp,"// Generated by VRiscV --aotgen from %s, do not edit\n",elf_file);
+    fprintf(fp,"// Build: gcc -O2 -shared -fPIC -o <lib>.so %s\n\n",out_file);
+    fputs(aot_prologue,fp);
+
+    // 按地址顺序为每个基本块生成一个函数
+    AotEntry *table = (AotEntry*)malloc(sizeof(AotEntry) * (blk_num + 1));
+    uint32_t func_num = 0;
+    uint64_t inst_total = 0;
+    for (uint32_t k = 0; k < seg_num; k++)
+    {
+        for (uint32_t idx = 0; idx < seg[k].size / 4; idx++)
+        {
+            if (!seg[k].leader[idx])
+                continue;
+            uint32_t pc = seg[k].base + 4 * idx;
+            uint32_t inst_num = scan_block(pc,dec);
+            if (inst_num == 0 || !can_gen(&dec[0],pc))
+                continue;
+            uint32_t hash = 2166136261u;
+            for (uint32_t i = 0; i < inst_num; i++)
+                hash = hash_step(hash,dec[i].inst);
+
+            fprintf(fp,"static AotRet b_%08x(uint32_t *restrict x)\n{\n",pc);
+            uint32_t i;
+            int res = 0;
+            for (i = 0; i < inst_num; i++)
+            {
+                if (!can_gen(&dec[i],pc + 4 * i))
+                    break;
+                res = gen_inst(fp,&dec[i],pc + 4 * i,i + 1);
+                if (res != 1)
+                    break;
+            }
+            if (res == 2)
+                i += 1;
+            else
+                // 基本块因为长度结束，或者遇到了无法翻译的指令
+                fprintf(fp,"    RET(0x%xu, %u);\n",pc + 4 * i,i);
+            fprintf(fp,"}\n\n");
+
+            table[func_num].pc = pc;
+            table[func_num].inst_num = inst_num;
+            table[func_num].hash = hash;
+            func_num += 1;
+            inst_total += i;
+        }
+    }
+
+    fprintf(fp,"const uint32_t aot_abi_version = %u;\n",AOT_ABI_VERSION);
+    fprintf(fp,"const uint32_t aot_table_num = %u;\n",func_num);
+    fprintf(fp,"const AotEntry aot_table[] = {\n");
+    for (uint32_t i = 0; i < func_num; i++)
+        fprintf(fp,"    {0x%08xu, %u, 0x%08xu, (void*)b_%08x},\n",
+                table[i].pc,table[i].inst_num,table[i].hash,table[i].pc);
+    fprintf(fp,"    {0, 0, 0, (void*)0}\n};\n");
+    fclose(fp);
+
+    printf("AOT: %u Blocks Discovered, %u Functions, %lu Instructions -> %s\n",
+           blk_num,func_num,inst_total,out_file);
+    free(table);
+    img_free(buf);
+    return 0;
+}
+
+// ----------------------------------------------
+// 运行时
+// ----------------------------------------------
+static AotStat aot_stat;
+static void *aot_so;
+static const AotEntry *aot_table;
+static uint32_t aot_num;
+static uint32_t *aot_idx;   // 按pc索引的开放地址哈希表，保存aot_table的下标加1
+static uint32_t aot_mask;
+
+static inline uint32_t aot_slot(uint32_t pc){
+    return (pc >> 2) * 2654435761u;
+}
+
+int aot_load(const char *so_file)
+{
+#ifdef RV64
+    printf("Error! AOT only supports RV32\n");
+    return 1;
+#endif
+    char path[4096];
+    // dlopen只在文件名包含'/'时按路径查找
+    if (strchr(so_file,'/') == NULL)
+        snprintf(path,sizeof(path),"./%s",so_file);
+    else
+        snprintf(path,sizeof(path),"%s",so_file);
+
+    aot_so = dlopen(path,RTLD_NOW | RTLD_LOCAL);
+    if (aot_so == NULL) {
+        printf("Error! Cannot load AOT library: %s\n",dlerror());
+        return 1;
+    }
+    const uint32_t *version = (const uint32_t*)dlsym(aot_so,"aot_abi_version");
+    const uint32_t *num = (const uint32_t*)dlsym(aot_so,"aot_table_num");
+    void (*bind)(void *const *) = (void (*)(void *const *))dlsym(aot_so,"aot_bind");
+    aot_table = (const AotEntry*)dlsym(aot_so,"aot_table");
+    if (version == NULL || num == NULL || bind == NULL || aot_table == NULL || *version != AOT_ABI_VERSION) {
+        printf("Error! Not a compatible AOT library: %s\n",so_file);
+        aot_free();
+        return 1;
+    }
+
+    static void *const helper[] = {
+        (void*)jit_lb, (void*)jit_lh, (void*)jit_lw, (void*)jit_lbu, (void*)jit_lhu,
+        (void*)jit_sb, (void*)jit_sh, (void*)jit_sw
+    };
+    bind(helper);
+
+    aot_num = *num;
+    aot_mask = 1;
+    while (aot_mask < aot_num * 2)
+        aot_mask <<= 1;
+    aot_idx = (uint32_t*)calloc(aot_mask,sizeof(uint32_t));
+    aot_mask -= 1;
+    for (uint32_t i = 0; i < aot_num; i++)
+    {
+        uint32_t s = aot_slot(aot_table[i].pc) & aot_mask;
+        while (aot_idx[s] != 0)
+            s = (s + 1) & aot_mask;
+        aot_idx[s] = i + 1;
+    }
+    memset(&aot_stat,0,sizeof(AotStat));
+    aot_stat.func = aot_num;
+    return 0;
+}
+
+void aot_free()
+{
+    if (aot_so != NULL)
+        dlclose(aot_so);
+    free(aot_idx);
+    aot_so = NULL;
+    aot_idx = NULL;
+    aot_table = NULL;
+    aot_num = 0;
+}
+
+void* aot_lookup(Block *blk)
+{
+    if (aot_num == 0)
+        return NULL;
+    uint32_t pc = (uint32_t)blk->pc;
+    for (uint32_t s = aot_slot(pc) & aot_mask; aot_idx[s] != 0; s = (s + 1) & aot_mask)
+    {
+        const AotEntry *e = &aot_table[aot_idx[s] - 1];
+        if (e->pc != pc)
+            continue;
+        uint32_t hash = 2166136261u;
+        for (uint32_t i = 0; i < blk->inst_num; i++)
+            hash = hash_step(hash,blk->op[i].dec.inst);
+        if (e->inst_num != blk->inst_num || e->hash != hash) {
+            aot_stat.stale += 1;
+            return NULL;
+        }
+        aot_stat.bound += 1;
+        return e->func;
+    }
+    aot_stat.miss += 1;
+    return NULL;
+}
+
+AotStat* get_aot_stat()
+{
+    return &aot_stat;
+}
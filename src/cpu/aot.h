@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// AOT静态重编译
+// 加载前从ELF的入口开始递归反汇编，找到所有可达的基本块，把每个基本块翻译成一个C函数
+// 生成的C文件由host的编译器编译成动态库，运行时通过--aot加载
+// 基本块的切分规则与block_cache一致，翻译基本块时按照起始地址，指令数和指令内容的哈希查找对应的函数，
+// 内容不一致（例如代码被改写）或者没有被发现的基本块仍然由执行引擎解释执行或者JIT编译
+// 生成的函数与JIT的本地代码接口相同，见jit_x64.h中的JitRet
+
+#ifndef __AOT_H__
+    #define __AOT_H__
+
+#include <stdint.h>
+#include "block_cache.h"
+
+#define AOT_ABI_VERSION 2   // 生成代码与模拟器之间的接口版本，不一致时拒绝加载
+
+// 动态库中的函数表，生成的C文件中有相同的定义
+typedef struct aot_entry_t
+{
+    uint32_t pc;        // 基本块的起始地址
+    uint32_t inst_num;  // 基本块的指令数
+    uint32_t hash;      // 基本块指令内容的哈希
+    void    *func;      // 基本块对应的函数
+} AotEntry;
+
+typedef struct aot_stat_t
+{
+    uint64_t func;      // 动态库中的函数数
+    uint64_t bound;     // 使用了AOT代码的基本块数
+    uint64_t stale;     // 起始地址相同，但是内容已经改变的基本块数
+    uint64_t miss;      // 没有AOT代码的基本块数
+} AotStat;
+
+// 从elf_file的入口开始递归反汇编，生成C文件out_file
+// 成功返回0，失败返回1
+int aot_gen(const char *elf_file, const char *out_file);
+
+// 加载由aot_gen生成的C文件编译得到的动态库
+// 成功返回0，失败返回1
+int aot_load(const char *so_file);
+void aot_free();
+
+// 查找与blk内容一致的AOT函数，没有时返回NULL
+void* aot_lookup(Block *blk);
+
+AotStat* get_aot_stat();
+
+#endif //__AOT_H__
@@ -31,6 +31,10 @@ SOFTWARE.
 #include "back_end.h"
 #include "sys_reg.h"
 #include "cpu_glb.h"
+#include "hle.h"
+#include "dec_cache.h"
+#include "block_cache.h"
+#include "../dev/memory.h"
 #include "../dev/int_ctrl.h"
 
 
@@ -38,9 +42,19 @@ SOFTWARE.
 static MXLEN_T x[32]; // 通用寄存器
 static MXLEN_T pc;
 static MXLEN_T next_pc;
+// store没有命中写TLB时，由mem_write()在写入之后调用
+// 写到了已经译码或者翻译的代码时使其失效，页中没有已经译码的代码时填入写TLB
+static void store_inval(uint64_t addr, uint8_t byte_num){
+    dec_cache_inval(addr,byte_num);
+    blk_cache_inval(addr,byte_num);
+    if (!dec_cache_has_page(addr))
+        tlb_fill_wr(addr);
+}
+
 // Exceptions
 // ----------------------------------------------
 void backend_init(){
+    mem_wr_hook = store_inval;
     // 初始化通用寄存器
     for (int i = 0; i < 32; i++)
     {
@@ -50,16 +64,28 @@ void backend_init(){
     sys_reg_reset();
 }
 
-// flags
-static ExeFlags flags;
 uint64_t jmp_cnt;
 uint64_t br_cnt;
 uint64_t br_taken_cnt;
-static void clear_flags(){
-    memset(&flags, 0, sizeof(ExeFlags));
+uint64_t fuse_cnt;      // 执行的融合指令对数
+#include "decode.h"
+
+// 按异常号trap到M模式，mtval为非法指令的内容或者异常时记录的信息
+static void exception_proc(ExeStatus *e_st, CPUMode curr_mode, uint32_t inst){
+    if (e_st->ecause == EXC_ILLEGAL_INST)
+        raise_illegal_instruction(curr_mode,(MXLEN_T)inst);
+    else
+        raise_exception(curr_mode,e_st->ecause,e_st->tval);
 }
 
-#include "decode.h"
+// trap处理完成后清除状态
+static void trap_clear(ExeStatus *e_st){
+    e_st->interupt = 0;
+    e_st->exception = 0;
+    e_st->branch = 0;
+    e_st->mret = 0;
+    e_st->icause = 0;
+}
 
 
 
@@ -71,9 +97,8 @@ void instruction_execute(ExeParam *exe_param)
     e_st->curr_pc = exe_param->pc;
     pc           = exe_param->pc;
     // decode
-    uint32_t inst  = *(exe_param->fetch_data_buf);
+    uint32_t inst  = exe_param->dec_inst->inst;
     e_st->inst = (MXLEN_T)inst;
-    clear_flags();
 
     // 处理取指过程中的异常
     if (exe_param->fetch_status->err_id > 0)
@@ -89,64 +114,23 @@ void instruction_execute(ExeParam *exe_param)
         e_st->interupt = 1;
     }
     else {
-        // 译码并执行指令
-        decode(inst,e_st);
+        // 分发并执行指令
+        dispatch(exe_param->dec_inst,e_st);
     }
 
-
-
-
-
-    if (x[0] != 0) printf("Error! Cannot write value to X0!");
-
     // 按优先级选择异常
     // 中断的优先级总是大于异常
     if (e_st->interupt) {
         trap2m(1,e_st->icause,curr_mode);
     }
     else if (e_st->exception){
-        if (e_st->ecause.ifetch_breakpoint)
-            trap2m(0,3,curr_mode);
-        else if (e_st->ecause.instruction_page_fault)
-            trap2m(0,12,curr_mode);
-        else if (e_st->ecause.instruction_access_fault)
-            trap2m(0,1,curr_mode);
-        else if (e_st->ecause.illegal_instruction){
-            raise_illegal_instruction(curr_mode,(MXLEN_T)inst);
-        }
-        else if (e_st->ecause.instruction_address_misaligned)
-            trap2m(0,0,curr_mode);
-        else if (e_st->ecause.ecall_from_u)
-            trap2m(0,8,curr_mode);
-        else if (e_st->ecause.ecall_from_s)
-            trap2m(0,9,curr_mode);
-        else if (e_st->ecause.ecall_from_m)
-            trap2m(0,11,curr_mode);
-        else if (e_st->ecause.ecall_breakpoint)
-            trap2m(0,3,curr_mode);
-        else if (e_st->ecause.lsu_breakpoint)
-            trap2m(0,3,curr_mode);
-        else if (e_st->ecause.load_page_fault)
-            trap2m(0,13,curr_mode);
-        else if (e_st->ecause.store_amo_page_fault)
-            trap2m(0,15,curr_mode);
-        else if (e_st->ecause.load_access_fault)
-            trap2m(0,5,curr_mode);
-        else if (e_st->ecause.store_access_fault)
-            trap2m(0,7,curr_mode);
-        else
-            printf("Error Cannot find the exception cause!");
+        exception_proc(e_st,curr_mode,inst);
     }
 
     if (e_st->interupt || e_st->exception || e_st->mret) {
         // next_pc是由异常处理函数计算出来的，已经更新到e_st中
         next_pc = e_st->next_pc;
-        e_st->interupt = 0;
-        e_st->exception = 0;
-        e_st->branch = 0;
-        e_st->mret = 0;
-        memset(&(e_st->ecause), 0, sizeof(ECause));
-        e_st->icause = 0;
+        trap_clear(e_st);
     }
     else if (e_st->branch) { // 处理分支指令
         e_st->next_pc = next_pc;
@@ -158,3 +142,35 @@ void instruction_execute(ExeParam *exe_param)
 
     instreth_inc(FETCH_NUM);
 }
+
+uint8_t x0_written()
+{
+    return x[0] != 0;
+}
+
+void read_xregs(MXLEN_T *dst)
+{
+    memcpy(dst,x,sizeof(x));
+}
+
+uint8_t hle_execute(uint64_t hle_pc, uint8_t id)
+{
+    ExeStatus *e_st = get_exe_st_ptr();
+    // 有中断需要处理，或者返回地址不对齐时，由guest代码执行
+    if ((x[1] & 3) != 0 || int_mask_proc(get_int_val(),get_cpu_mode()) > 0)
+        return 0;
+    if (hle_call(id,x) != 0)
+        return 0;
+    e_st->curr_pc = hle_pc;
+    e_st->next_pc = x[1];
+    instreth_inc(1);
+    return 1;
+}
+
+uint64_t get_fuse_cnt()
+{
+    return fuse_cnt;
+}
+
+#include "threaded.h"
+#include "block_exec.h"
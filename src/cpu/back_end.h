@@ -29,6 +29,7 @@ SOFTWARE.
 #include "cpu_config.h"
 #include "cpu_glb.h"
 #include "front_end.h"
+#include "predecode.h"
 
 typedef struct exe_param
 {
@@ -37,11 +38,33 @@ typedef struct exe_param
     InstSet  inst_set;       //指令集：16，32，64
     FetchStatus *fetch_status;
     uint32_t *fetch_data_buf;
+    DecInst  *dec_inst;     //前端给出的译码结果
 }ExeParam;
 
 
 void instruction_execute(ExeParam* exe_param);
 
+// threaded code 引擎，从start_pc开始最多执行budget条指令
+// 返回实际退休的指令数，返回0时表示需要由instruction_execute()执行当前指令
+uint64_t threaded_execute(uint64_t start_pc, uint64_t budget);
+
+// 基本块引擎，参数和返回值与threaded_execute()相同
+uint64_t block_execute(uint64_t start_pc, uint64_t budget);
+
+// x0被写入非0值时返回1，只由插桩的执行循环逐条检查
+uint8_t x0_written();
+
+// 复制32个通用寄存器的值，供lockstep比较使用
+void read_xregs(MXLEN_T *dst);
+
+// hle_pc是编号为id的HLE入口，id由调用者用hle_lookup()得到，见hle.h
+// 由host完成调用并从ra返回，计为一条指令
+// 返回1表示已经执行，e_st->next_pc为返回地址；返回0时需要逐条执行当前指令
+uint8_t hle_execute(uint64_t hle_pc, uint8_t id);
+
+// 执行引擎执行的融合指令对数
+uint64_t get_fuse_cnt();
+
 // op
 #define OP_32     0b00110011
 #define LOAD      0b00000011
@@ -57,22 +80,6 @@ void instruction_execute(ExeParam* exe_param);
 // func7
 #define MULDIV    0b00000001
 
-typedef struct exe_flags
-{
-    uint8_t is_branch;
-    uint8_t is_jump;
-    uint8_t is_alu;
-    uint8_t is_mul;
-    uint8_t is_div;
-    uint8_t is_shift;
-    uint8_t is_cmp;
-    uint8_t is_csr;
-    uint8_t is_store;
-    uint8_t is_load;
-    uint8_t is_li;
-    uint8_t is_sys;
-}ExeFlags;
-
 typedef struct excpt_t
 {
     uint8_t exception_vaild;
@@ -0,0 +1,439 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "block_cache.h"
+#include "front_end.h"
+#include "predecode.h"
+#include "dec_cache.h"
+#include "jit_x64.h"
+#include "aot.h"
+#include "hle.h"
+#include "../dev/dev_config.h"
+#include "../dev/memory.h"
+#include "../dev/mem_pool.h"
+#include "../include/comm.h"
+
+static uint8_t *blk_arena;       // 基本块使用的内存
+static uint64_t blk_arena_used;
+static Block   *blk_hash [BLK_HASH_SIZE];
+static Block   *blk_page [BLK_HASH_SIZE];  // 按页组织的基本块链表，用于查找被改写的基本块
+static uint64_t  blk_page_used [BLK_HASH_SIZE / 64]; // 非空的页链表，fence.i只检查这些链表
+static Block   *sb_list;                  // 所有superblock
+static Block   *blk_free [BLK_MAX_INST + 1]; // 失效后回收的基本块，按指令数分类
+static uint64_t gen;
+static uint64_t flush_gen;
+static BlkCacheStat blk_stat;
+
+static inline uint32_t blk_hash_idx(uint64_t pc){
+    return (uint32_t)((pc >> 2) & (BLK_HASH_SIZE - 1));
+}
+
+static inline uint32_t blk_page_idx(uint64_t addr){
+    return (uint32_t)((addr / DEC_PAGE_SIZE) & (BLK_HASH_SIZE - 1));
+}
+
+static inline int is_dram(uint64_t addr){
+    return (addr >= DRAM_BASE && addr <= DRAM_END);
+}
+
+void blk_cache_flush()
+{
+    blk_arena_used = 0;
+    memset(blk_hash, 0, sizeof(blk_hash));
+    memset(blk_page, 0, sizeof(blk_page));
+    memset(blk_page_used, 0, sizeof(blk_page_used));
+    memset(blk_free, 0, sizeof(blk_free));
+    sb_list = NULL;
+    mem_pool_clear_code();
+    gen += 1;
+    flush_gen += 1;
+    blk_stat.flush += 1;
+}
+
+void blk_cache_init()
+{
+    blk_arena = (uint8_t*)malloc(BLK_ARENA_SIZE);
+    blk_arena_used = 0;
+    memset(blk_hash, 0, sizeof(blk_hash));
+    memset(blk_page, 0, sizeof(blk_page));
+    memset(blk_page_used, 0, sizeof(blk_page_used));
+    memset(blk_free, 0, sizeof(blk_free));
+    sb_list = NULL;
+    memset(&blk_stat, 0, sizeof(BlkCacheStat));
+    gen = 0;
+    flush_gen = 0;
+}
+
+void blk_cache_free()
+{
+    free(blk_arena);
+    blk_arena = NULL;
+}
+
+static inline uint64_t blk_size(uint32_t inst_num){
+    uint64_t size = sizeof(Block) + (inst_num + 1) * sizeof(BlkOp);
+    return ROUND(size + 7, 8);
+}
+
+static Block* blk_alloc(uint32_t inst_num){
+    if (blk_free[inst_num] != NULL) {
+        Block *blk = blk_free[inst_num];
+        blk_free[inst_num] = blk->hash_next;
+        return blk;
+    }
+    uint64_t size = blk_size(inst_num);
+    if (blk_arena_used + size > BLK_ARENA_SIZE)
+        blk_cache_flush();
+    Block *blk = (Block*)(blk_arena + blk_arena_used);
+    blk_arena_used += size;
+    return blk;
+}
+
+static inline int is_cond_branch(uint8_t id){
+    return (id >= INST_BEQ && id <= INST_BGEU);
+}
+
+Block* blk_cache_get(uint64_t pc, const void *const *handler, const void *end_handler)
+{
+    uint32_t idx = blk_hash_idx(pc);
+    for (Block *blk = blk_hash[idx]; blk != NULL; blk = blk->hash_next)
+    {
+        if (blk->pc == pc)
+            return blk;
+    }
+
+    if (blk_arena == NULL || !is_dram(pc) || MOD(pc,4) != 0)
+        return NULL;
+
+    // 收集基本块中的指令，基本块不跨页
+    DecInst *dec[BLK_MAX_INST];
+    uint32_t inst_num = 0;
+    uint64_t addr = pc;
+    while (inst_num < BLK_MAX_INST)
+    {
+        DecInst *d = fetch_dec_inst(addr);
+        if (d == NULL)
+            break;
+        dec[inst_num++] = d;
+        addr += 4;
+        if (is_blk_end(d->id) || MOD(addr,DEC_PAGE_SIZE) == 0)
+            break;
+    }
+    if (inst_num == 0)
+        return NULL;
+
+    Block *blk = blk_alloc(inst_num);
+    blk->pc = pc;
+    blk->inst_num = inst_num;
+    blk->next[0] = NULL;
+    blk->next[1] = NULL;
+    blk->exec_cnt = 0;
+    blk->br_cnt = 0;
+    blk->br_taken_cnt = 0;
+    blk->tier = 0;
+    blk->pending = 0;
+    blk->native = NULL;
+    blk->super = NULL;
+    blk->trace = NULL;
+    for (uint32_t i = 0; i < inst_num; i++)
+    {
+        // 融合指令对的第二条也在基本块中时才使用融合的handler
+        blk->op[i].handler = handler[(i + 1 < inst_num) ? dec[i]->hid : dec[i]->id];
+        blk->op[i].dec = *dec[i];
+    }
+    blk->op[inst_num].handler = end_handler;
+    memset(&(blk->op[inst_num].dec), 0, sizeof(DecInst));
+    idiom_match(pc,(const DecInst *const *)dec,inst_num,&(blk->idiom));
+    blk->hle = hle_lookup(pc);
+    // 有AOT代码时直接使用，不再进入JIT的各层
+    blk->native = aot_lookup(blk);
+    if (blk->native != NULL)
+        blk->tier = JIT_TIER_OPT;
+
+    // 如果分配时清空了缓存，idx对应的链表也已经清空
+    blk->hash_next = blk_hash[idx];
+    blk_hash[idx] = blk;
+    uint32_t page_idx = blk_page_idx(pc);
+    blk->page_next = blk_page[page_idx];
+    blk_page[page_idx] = blk;
+    blk_page_used[page_idx / 64] |= (uint64_t)1 << (page_idx % 64);
+    mem_pool_set_code(pc,1);
+    tlb_flush_wr(pc);
+    blk_stat.translate += 1;
+    return blk;
+}
+
+void blk_cache_chained()
+{
+    blk_stat.chain += 1;
+}
+
+// 路径上blk之后的基本块，没有确定的后继时返回NULL
+static Block* trace_next(Block *blk){
+    DecInst *last = &(blk->op[blk->inst_num - 1].dec);
+    uint64_t end_pc = blk->pc + 4 * blk->inst_num;
+    uint64_t jmp_pc = end_pc - 4 + (uint64_t)(int64_t)(last->imm);
+    Block *nb;
+
+    if (is_cond_branch(last->id)) {
+        // 只选择方向稳定的分支
+        if (blk->br_cnt < TRACE_MIN_CNT)
+            return NULL;
+        if ((uint64_t)(blk->br_taken_cnt) * TRACE_BIAS >= (uint64_t)(blk->br_cnt) * (TRACE_BIAS - 1)) {
+            nb = blk->next[1];
+            end_pc = jmp_pc;
+        }
+        else if ((uint64_t)(blk->br_cnt - blk->br_taken_cnt) * TRACE_BIAS >= (uint64_t)(blk->br_cnt) * (TRACE_BIAS - 1))
+            nb = blk->next[0];
+        else
+            return NULL;
+    }
+    else if (last->id == INST_JAL) {
+        nb = blk->next[1];
+        end_pc = jmp_pc;
+    }
+    else if (is_blk_end(last->id))
+        // jalr的目标不固定，SYSTEM指令需要退出引擎
+        return NULL;
+    else
+        // 因为长度或者页边界结束
+        nb = blk->next[0];
+    // 后继还没有链接时，说明这个方向很少执行
+    // 链接的基本块失效后可能已经被回收，pc不一致时不能使用
+    if (nb == NULL || nb->pc != end_pc)
+        return NULL;
+    return nb;
+}
+
+Block* blk_cache_trace(Block *head)
+{
+    Block *path[TRACE_MAX_BLK];
+    uint32_t blk_num = 0;
+    uint32_t inst_num = 0;
+    Block *blk = head;
+
+    while (blk != NULL && blk_num < TRACE_MAX_BLK && inst_num + blk->inst_num <= TRACE_MAX_INST)
+    {
+        // 回到路径上已有的基本块时结束，通过链接重新进入
+        for (uint32_t k = 0; k < blk_num; k++)
+        {
+            if (path[k] == blk)
+                goto path_done;
+        }
+        // HLE的入口需要在基本块的边界由执行引擎处理
+        if (blk->hle && blk_num > 0)
+            break;
+        path[blk_num++] = blk;
+        inst_num += blk->inst_num;
+        blk = trace_next(blk);
+    }
+path_done:
+    if (blk_num < 2)
+        return NULL;
+
+    // 不能在这里清空缓存，调用者还持有head
+    uint64_t size = blk_size(inst_num) + ROUND(sizeof(Trace) + 7, 8);
+    if (blk_arena_used + size > BLK_ARENA_SIZE)
+        return NULL;
+    Block *sb = (Block*)(blk_arena + blk_arena_used);
+    blk_arena_used += size;
+    Trace *trace = (Trace*)((uint8_t*)sb + blk_size(inst_num));
+
+    memset(sb, 0, sizeof(Block));
+    sb->pc = head->pc;
+    sb->inst_num = inst_num;
+    sb->trace = trace;
+    trace->blk_num = blk_num;
+    inst_num = 0;
+    for (uint32_t k = 0; k < blk_num; k++)
+    {
+        trace->path[k] = path[k];
+        trace->off[k] = inst_num;
+        memcpy(&(sb->op[inst_num]), path[k]->op, path[k]->inst_num * sizeof(BlkOp));
+        inst_num += path[k]->inst_num;
+    }
+    // 结束标记
+    sb->op[inst_num] = path[blk_num - 1]->op[path[blk_num - 1]->inst_num];
+
+    // superblock不在哈希表中，借用hash_next串成链表，路径上的基本块失效时一起失效
+    sb->hash_next = sb_list;
+    sb_list = sb;
+    blk_stat.trace += 1;
+    blk_stat.trace_blk += blk_num;
+    return sb;
+}
+
+// 从哈希表中移除，并标记为失效，调用者负责从页链表中移除
+static void blk_kill(Block *blk){
+    Block **pp = &blk_hash[blk_hash_idx(blk->pc)];
+    while (*pp != blk)
+        pp = &((*pp)->hash_next);
+    *pp = blk->hash_next;
+    blk->pc = BLK_DEAD_PC;
+    blk_stat.inval += 1;
+    // 按指令数回收，反复改写同一段代码时重新翻译的基本块大小相同
+    // 其他基本块中指向这里的链接会因为pc不相等而重新查找
+    // 后台编译的结果要安装到blk上，还没有完成时不能回收
+    if (!blk->pending) {
+        blk->hash_next = blk_free[blk->inst_num];
+        blk_free[blk->inst_num] = blk;
+    }
+}
+
+// 路径上有基本块失效的superblock也失效
+static void trace_inval(){
+    Block **pp = &sb_list;
+    while (*pp != NULL)
+    {
+        Block *sb = *pp;
+        uint32_t k = 0;
+        while (k < sb->trace->blk_num && !blk_is_dead(sb->trace->path[k]))
+            k += 1;
+        if (k == sb->trace->blk_num) {
+            pp = &(sb->hash_next);
+            continue;
+        }
+        if (sb->trace->path[0]->super == sb)
+            sb->trace->path[0]->super = NULL;
+        sb->pc = BLK_DEAD_PC;
+        *pp = sb->hash_next;
+        blk_stat.inval += 1;
+    }
+}
+
+// 与[start_addr, end_addr]重叠的基本块失效，返回失效的数量
+// 页中不再有基本块时清除内存池中的代码标记
+static uint32_t page_inval(uint64_t page_tag, uint64_t start_addr, uint64_t end_addr){
+    uint32_t kill_num = 0;
+    uint32_t remain = 0;
+    uint32_t page_idx = blk_page_idx(page_tag);
+    Block **pp = &blk_page[page_idx];
+    while (*pp != NULL)
+    {
+        Block *blk = *pp;
+        if (ROUND(blk->pc,DEC_PAGE_SIZE) != page_tag) {
+            pp = &(blk->page_next);
+            continue;
+        }
+        if (blk->pc > end_addr || blk->pc + 4 * blk->inst_num <= start_addr) {
+            remain += 1;
+            pp = &(blk->page_next);
+            continue;
+        }
+        *pp = blk->page_next;
+        blk_kill(blk);
+        kill_num += 1;
+    }
+    if (remain == 0)
+        mem_pool_set_code(page_tag,0);
+    if (blk_page[page_idx] == NULL)
+        blk_page_used[page_idx / 64] &= ~((uint64_t)1 << (page_idx % 64));
+    return kill_num;
+}
+
+void blk_cache_inval(uint64_t addr, uint8_t byte_num)
+{
+    if (byte_num == 0 || blk_arena_used == 0)
+        return;
+
+    uint64_t end_addr = addr + byte_num - 1;
+    uint32_t kill_num = 0;
+    for (uint64_t a = ROUND(addr,DEC_PAGE_SIZE); a <= end_addr; a += DEC_PAGE_SIZE)
+    {
+        if (is_dram(a) && mem_pool_is_code(a))
+            kill_num += page_inval(a,addr,end_addr);
+    }
+    if (kill_num > 0) {
+        trace_inval();
+        gen += 1;
+    }
+}
+
+// 基本块中的指令与内存中的不一致
+static int blk_stale(Block *blk){
+    uint8_t *mem = mem_pool_lkup(ROUND(blk->pc,DEC_PAGE_SIZE)) + MOD(blk->pc,DEC_PAGE_SIZE);
+    for (uint32_t i = 0; i < blk->inst_num; i++)
+    {
+        uint32_t inst;
+        memcpy(&inst,mem + 4 * i,4);
+        if (inst != blk->op[i].dec.inst)
+            return 1;
+    }
+    return 0;
+}
+
+void blk_cache_fence()
+{
+    blk_stat.fence += 1;
+    if (blk_arena_used == 0)
+        return;
+
+    uint32_t kill_num = 0;
+    for (uint32_t w = 0; w < BLK_HASH_SIZE / 64; w++)
+    {
+        uint64_t used = blk_page_used[w];
+        while (used != 0)
+        {
+            uint32_t i = w * 64 + (uint32_t)__builtin_ctzll(used);
+            used &= used - 1;
+            Block **pp = &blk_page[i];
+            while (*pp != NULL)
+            {
+                Block *blk = *pp;
+                if (!blk_stale(blk)) {
+                    pp = &(blk->page_next);
+                    continue;
+                }
+                *pp = blk->page_next;
+                blk_kill(blk);
+                kill_num += 1;
+            }
+            if (blk_page[i] == NULL)
+                blk_page_used[w] &= ~((uint64_t)1 << (i % 64));
+        }
+    }
+    if (kill_num > 0) {
+        trace_inval();
+        gen += 1;
+    }
+}
+
+uint64_t blk_cache_gen()
+{
+    return gen;
+}
+
+uint64_t blk_cache_flush_gen()
+{
+    return flush_gen;
+}
+
+BlkCacheStat* get_blk_cache_stat()
+{
+    return &blk_stat;
+}
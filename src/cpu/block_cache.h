@@ -0,0 +1,180 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// 基本块缓存
+// 以分支，跳转和SYSTEM指令为结尾，将guest代码切分成基本块
+// 每个基本块只翻译一次，翻译结果是一组已经绑定好handler的micro-op
+// 基本块之间通过next[]直接链接，执行引擎不需要每次都查询缓存
+// 所有基本块都分配在一块连续的内存中，空间用完时整体清空
+// 内存池中记录每一页是否有已经翻译的代码，写到这些页或者执行fence.i时，
+// 只有被改写的基本块和经过它们的superblock失效
+// 使能JIT时，热点基本块沿着结尾分支的主要方向连接成superblock（trace），
+// superblock只有一个入口，偏离路径的分支方向作为旁路出口
+
+#ifndef __BLOCK_CACHE_H__
+    #define __BLOCK_CACHE_H__
+
+#include <stdint.h>
+#include "predecode.h"
+#include "idiom.h"
+
+#define BLK_MAX_INST    64               // 基本块的最大指令数
+#define BLK_HASH_SIZE   4096             // 哈希表大小，必须是2的幂
+#define BLK_ARENA_SIZE  (8 * 1024 * 1024) // 基本块使用的内存大小
+
+#define TRACE_MAX_BLK   8                // superblock最多包含的基本块数
+#define TRACE_MAX_INST  (BLK_MAX_INST * 2) // superblock的最大指令数
+#define TRACE_MIN_CNT   16               // 分支至少执行多少次后才用于选择路径
+#define TRACE_BIAS      8                // 分支的一个方向至少占 (TRACE_BIAS-1)/TRACE_BIAS 时才会被选入路径
+
+#define BLK_DEAD_PC     1                // 失效的基本块的pc，不对齐，不会与任何地址相等
+
+typedef struct blk_op_t
+{
+    const void *handler;    // 执行引擎中对应的handler
+    DecInst     dec;
+} BlkOp;
+
+typedef struct block_t
+{
+    uint64_t pc;                // 基本块的起始地址
+    uint32_t inst_num;          // 基本块的指令数
+    struct block_t *next[2];    // 链接的后继基本块，0：顺序执行，1：跳转
+    struct block_t *hash_next;  // 哈希表中的下一个，superblock用来串成链表
+    struct block_t *page_next;  // 同一个页链表中的下一个
+    uint32_t exec_cnt;          // 执行次数，用于选择需要编译的热点基本块
+    uint32_t br_cnt;            // 结尾分支的执行次数
+    uint32_t br_taken_cnt;      // 结尾分支跳转的次数
+    uint8_t  tier;              // 执行层级，见jit_x64.h中的JitTier
+    uint8_t  pending;           // 已经提交给后台编译线程，还没有安装
+    void    *native;            // JIT生成的本地代码，没有编译时为NULL
+    struct block_t *super;      // 以该基本块为入口的superblock，没有时为NULL
+    struct trace_t *trace;      // superblock经过的基本块，普通基本块为NULL
+    Idiom    idiom;             // 识别出的循环模式，见idiom.h
+    uint8_t  hle;               // 基本块的起始地址是HLE的入口时为入口编号，见hle.h
+    BlkOp    op[];              // inst_num条指令，再加上一个结束标记
+} Block;
+
+// superblock的路径，op[]由路径上各个基本块的指令依次拼接而成
+typedef struct trace_t
+{
+    uint32_t blk_num;
+    Block   *path[TRACE_MAX_BLK];
+    uint32_t off[TRACE_MAX_BLK];   // 各个基本块的第一条指令在op[]中的位置
+} Trace;
+
+typedef struct blk_cache_stat_t
+{
+    uint64_t translate; // 翻译的基本块数
+    uint64_t chain;     // 建立的链接数
+    uint64_t flush;     // 清空的次数
+    uint64_t inval;     // 因为代码被改写而失效的基本块数，包括superblock
+    uint64_t fence;     // 执行fence.i的次数
+    uint64_t trace;     // 建立的superblock数
+    uint64_t trace_blk; // superblock包含的基本块数
+    uint64_t trace_inst;// 在superblock中执行的指令数
+    uint64_t trace_exit;// 从superblock旁路出口离开的次数
+    uint64_t ras_hit;   // 返回地址栈预测正确的函数返回
+    uint64_t ras_miss;  // 返回地址栈为空或者预测错误的函数返回
+    uint64_t ibtc_hit;  // 间接跳转目标缓存命中的次数
+    uint64_t ibtc_miss; // 间接跳转目标缓存缺失的次数
+} BlkCacheStat;
+
+// 基本块的结尾指令
+static inline int is_blk_end(uint8_t id){
+    switch (id)
+    {
+    case INST_BEQ:  case INST_BNE:  case INST_BLT:
+    case INST_BGE:  case INST_BLTU: case INST_BGEU:
+    case INST_JAL:  case INST_JALR:
+    case INST_ECALL:case INST_EBREAK:case INST_MRET:
+    case INST_CSRRW: case INST_CSRRS: case INST_CSRRC:
+    case INST_CSRRWI:case INST_CSRRSI:case INST_CSRRCI:
+    case INST_NONE: case INST_ILLEGAL:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+void blk_cache_init();
+void blk_cache_free();
+
+// 查询pc开始的基本块，缺失时进行翻译
+// handler为InstID和FuseID到handler的映射，end_handler为基本块的结束标记
+// 无法取指时返回NULL
+Block* blk_cache_get(uint64_t pc, const void *const *handler, const void *end_handler);
+
+// 记录一次链接
+void blk_cache_chained();
+
+// 从head开始，沿着已经链接的后继和分支的主要方向选择一条路径，建立superblock
+// superblock不加入哈希表，只能通过head->super进入
+// 路径不足两个基本块或者空间不足时返回NULL，不会清空缓存
+Block* blk_cache_trace(Block *head);
+
+// 基本块已经失效，之前建立的链接不会再命中
+static inline int blk_is_dead(Block *blk){
+    return blk->pc == BLK_DEAD_PC;
+}
+
+// superblock中第idx条指令所在的基本块，普通基本块返回自身
+static inline Block* blk_op_blk(Block *blk, uint32_t idx){
+    if (blk->trace == NULL)
+        return blk;
+    uint32_t k = blk->trace->blk_num - 1;
+    while (blk->trace->off[k] > idx)
+        k -= 1;
+    return blk->trace->path[k];
+}
+
+// superblock中第idx条指令的地址
+static inline uint64_t blk_op_pc(Block *blk, uint32_t idx){
+    if (blk->trace == NULL)
+        return blk->pc + 4 * idx;
+    uint32_t k = blk->trace->blk_num - 1;
+    while (blk->trace->off[k] > idx)
+        k -= 1;
+    return blk->trace->path[k]->pc + 4 * (idx - blk->trace->off[k]);
+}
+
+// 清空所有基本块，调用后之前得到的Block指针全部失效
+void blk_cache_flush();
+
+// 地址[addr, addr + byte_num)被写入，与写入范围重叠的基本块失效
+// 只有页中有已经翻译的代码时才需要查找
+void blk_cache_inval(uint64_t addr, uint8_t byte_num);
+
+// fence.i：与内存中的指令不一致的基本块失效，用于store以外的方式改写的代码
+void blk_cache_fence();
+
+// 每次清空缓存或者有基本块失效后加1，之前得到的Block指针可能已经失效
+uint64_t blk_cache_gen();
+
+// 每次清空缓存后加1，清空之前得到的Block指针和生成的代码全部失效
+uint64_t blk_cache_flush_gen();
+
+BlkCacheStat* get_blk_cache_stat();
+
+#endif //__BLOCK_CACHE_H__
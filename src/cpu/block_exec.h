@@ -0,0 +1,371 @@
+
+// 基本块执行引擎
+// 以基本块为单位执行block_cache中翻译好的micro-op
+// 基本块内部顺序执行，结尾的分支指令执行后，通过next[]直接进入后继基本块，不再返回cpu_run()
+// 中断和执行数量的检查只在基本块的边界进行
+// 使能JIT时，热点基本块会被编译为本地代码，见jit_x64.h
+// 加载了AOT代码时，基本块在翻译时就绑定了本地代码，见aot.h
+// jalr的目标不固定，函数返回由返回地址栈预测，其他间接跳转查询间接跳转目标缓存
+// 识别出的复制，填充和扫描循环由host一次完成，见idiom.h
+// HLE的入口由host完成调用后，按照函数返回进入ra处的基本块，见hle.h
+// handler的实现见engine_body.h
+// 本文件只能被back_end.c包含，需要使用其中的x[]，pc，next_pc等状态
+
+#include <stdint.h>
+#include "back_end.h"
+#include "execution.h"
+#include "predecode.h"
+#include "block_cache.h"
+#include "jit_x64.h"
+#include "idiom.h"
+#include "hle.h"
+#include "../dev/int_ctrl.h"
+#include "engine_ops.h"
+
+#define IBTC_SIZE   1024    // 间接跳转目标缓存的大小，必须是2的幂
+#define RAS_SIZE    32      // 返回地址栈的深度，必须是2的幂
+
+typedef struct ras_entry_t
+{
+    uint64_t pc;        // 返回地址
+    Block   *caller;    // 调用所在的基本块，caller->next[0]链接返回地址处的基本块
+} RasEntry;
+
+// 以目标地址索引，只缓存基本块的指针，使用前需要检查pc
+static Block   *ibtc [IBTC_SIZE];
+// 环形的返回地址栈，溢出时覆盖最早的表项
+static RasEntry ras [RAS_SIZE];
+static uint32_t ras_top;
+static uint32_t ras_num;
+static uint64_t pred_gen;   // 对应的基本块缓存清空的版本
+// HLE完成调用后，按照ret（jalr x0, 0(ra)）进入返回地址
+static DecInst hle_ret = {.id = INST_JALR, .hid = INST_JALR, .rs1 = 1};
+
+// 基本块缓存被清空后，保存的Block指针全部失效
+static inline void pred_sync(){
+    if (blk_cache_flush_gen() == pred_gen)
+        return;
+    memset(ibtc, 0, sizeof(ibtc));
+    ras_num = 0;
+    pred_gen = blk_cache_flush_gen();
+}
+
+static inline uint32_t ibtc_idx(uint64_t pc){
+    return (uint32_t)((pc >> 2) & (IBTC_SIZE - 1));
+}
+
+// x1和x5是链接寄存器，见RISC-V手册2.5节中jalr的返回地址栈提示
+static inline int is_link(uint8_t r){
+    return (r == 1 || r == 5);
+}
+
+static inline void ras_push(uint64_t ret_pc, Block *caller){
+    ras_top = (ras_top + 1) & (RAS_SIZE - 1);
+    ras[ras_top].pc = ret_pc;
+    ras[ras_top].caller = caller;
+    if (ras_num < RAS_SIZE)
+        ras_num += 1;
+}
+
+static inline RasEntry* ras_pop(){
+    if (ras_num == 0)
+        return NULL;
+    RasEntry *ent = &ras[ras_top];
+    ras_top = (ras_top - 1) & (RAS_SIZE - 1);
+    ras_num -= 1;
+    return ent;
+}
+
+// superblock的本地代码执行了前done条指令，路径内部的分支都沿着路径的方向执行
+// 与解释执行时一样更新分支计数，以及各个基本块的分支方向
+static void trace_profile(Block *blk, uint32_t done){
+    Trace *trace = blk->trace;
+    for (uint32_t k = 0; k + 1 < trace->blk_num && trace->off[k + 1] <= done; k++)
+    {
+        Block *b = trace->path[k];
+        uint8_t id = b->op[b->inst_num - 1].dec.id;
+        uint8_t taken = (trace->path[k + 1]->pc != b->pc + 4 * b->inst_num);
+        if (id >= INST_BEQ && id <= INST_BGEU) {
+            br_cnt += 1;
+            br_taken_cnt += taken;
+        }
+        else if (id == INST_JAL) {
+            jmp_cnt += 1;
+            // 路径中间的函数调用不会回到执行引擎，在这里压栈
+            if (is_link(b->op[b->inst_num - 1].dec.rd))
+                ras_push(b->pc + 4 * b->inst_num,b);
+        }
+        else
+            continue;
+        b->br_cnt += 1;
+        b->br_taken_cnt += taken;
+    }
+}
+
+uint64_t block_execute(uint64_t start_pc, uint64_t budget)
+{
+    static const void *const handler[HANDLER_NUM] = { ENG_HANDLER_TABLE };
+
+    ExeStatus *e_st = get_exe_st_ptr();
+    CPUMode curr_mode = get_cpu_mode();
+    uint64_t retired = 0; // 已经退休的指令数
+    uint64_t counted = 0; // 已经计入instret的指令数
+    uint64_t gen = blk_cache_gen();
+    Block *blk;
+    Block *next_blk;
+    BlkOp *op;
+    DecInst *d;
+    int slot = 0;
+    BlkCacheStat *bc_stat = get_blk_cache_stat();
+    Block *idiom_skip = NULL;   // 本次循环已经不满足条件的基本块
+
+    // 安装后台线程编译完成的代码
+    jit_drain();
+    // 代码缓存用完时，在还没有持有任何基本块的时候清空
+    if (jit_code_full())
+        blk_cache_flush();
+    pred_sync();
+
+    pc = start_pc;
+    blk = blk_cache_get(pc,handler,&&blk_end);
+    if (blk == NULL)
+        return 0;
+    gen = blk_cache_gen();
+
+blk_enter:
+    // HLE的入口，由host完成调用后从ra返回
+    // 有中断需要处理时，仍然按照普通基本块在边界退出
+    if (blk->hle && retired < budget && (x[1] & 3) == 0 &&
+        !(int_maybe_pending() && int_mask_proc(get_int_val(),curr_mode) > 0) &&
+        hle_call(blk->hle,x) == 0)
+    {
+        retired += 1;
+        e_st->curr_pc = pc;
+        pc = x[1];
+        d = &hle_ret;
+        goto blk_jump;
+    }
+    // 识别出的循环，剩余的数量允许的迭代由host一次完成
+    // 有中断需要处理时，仍然按照普通基本块在边界退出
+    if (blk != idiom_skip)
+        idiom_skip = NULL;
+    if (blk->idiom.kind != IDIOM_NONE && blk != idiom_skip && budget - retired >= blk->inst_num &&
+        !(int_maybe_pending() && int_mask_proc(get_int_val(),curr_mode) > 0))
+    {
+        uint8_t idiom_done;
+        uint64_t iter = idiom_execute(&(blk->idiom),x,(budget - retired) / blk->inst_num,&idiom_done);
+        if (iter > 0)
+        {
+            retired += iter * blk->inst_num;
+            get_idiom_stat()->inst += iter * blk->inst_num;
+            // 除了最后一次迭代，结尾分支都跳回循环的开始
+            br_cnt += iter;
+            br_taken_cnt += iter - idiom_done;
+            blk->br_cnt += iter;
+            blk->br_taken_cnt += iter - idiom_done;
+            e_st->curr_pc = blk->pc + 4 * (blk->inst_num - 1);
+            slot = !idiom_done;
+            pc = idiom_done ? e_st->curr_pc + 4 : blk->pc;
+            goto blk_chain;
+        }
+        // 不满足条件时，这一次循环剩余的迭代都由handler执行，不再重复检查
+        idiom_skip = blk;
+    }
+    // 有superblock时从superblock进入，剩余的数量不够时仍然执行原来的基本块
+    if (blk->super != NULL && budget - retired >= blk->super->inst_num)
+        blk = blk->super;
+    // 剩余的数量不够执行整个基本块，或者有中断需要处理时，退出引擎
+    // 还没有执行任何指令时返回0，由instruction_execute()逐条执行
+    if (budget - retired < blk->inst_num)
+        goto eng_exit;
+    if (int_maybe_pending() && int_mask_proc(get_int_val(),curr_mode) > 0)
+        goto eng_exit;
+    op = blk->op;
+#ifdef JIT_SUPPORT
+    // 执行次数达到阈值后进入下一层，JIT没有初始化时阈值为最大值
+    if (++blk->exec_cnt >= jit_tier_hot[blk->tier])
+        jit_tier_up(blk);
+#endif
+    if (blk->native != NULL)
+    {
+        JitRet ret = ((JitFunc)(blk->native))(x);
+        uint32_t done = (uint32_t)(ret.retired & ~(uint64_t)JIT_RET_XFER);
+        uint8_t xfer = (ret.retired & JIT_RET_XFER) != 0;
+        retired += done;
+        pc = ret.next_pc;
+        if (blk->trace != NULL) {
+            bc_stat->trace_inst += done;
+            trace_profile(blk,xfer ? done - 1 : done);
+        }
+        // store写到了已经翻译的代码，blk可能已经失效
+        if (blk_cache_gen() != gen) {
+            e_st->curr_pc = pc - 4;
+            goto eng_exit;
+        }
+        if (xfer)
+        {
+            // 执行到了分支或者跳转，superblock中也可能是旁路出口
+            e_st->curr_pc = blk_op_pc(blk,done - 1);
+            slot = (pc != e_st->curr_pc + 4);
+            d = &(blk->op[done - 1].dec);
+            if (d->id >= INST_BEQ && d->id <= INST_BGEU) {
+                br_cnt += 1;
+                br_taken_cnt += slot;
+            }
+            else
+                jmp_cnt += 1;
+            Block *site = blk_op_blk(blk,done - 1);
+            site->br_cnt += 1;
+            site->br_taken_cnt += slot;
+            if (done < blk->inst_num)
+                bc_stat->trace_exit += 1;
+            if (d->id == INST_JAL || d->id == INST_JALR)
+                goto blk_jump;
+            goto blk_chain;
+        }
+        // 因为长度或者页边界结束
+        if (done == blk->inst_num)
+            goto blk_end;
+        // 剩余的指令由handler执行
+        op += done;
+    }
+    d = &(op->dec);
+    goto *(op->handler);
+
+blk_end:
+    // 基本块因为长度或者页边界结束，顺序进入下一个基本块
+    e_st->curr_pc = pc - 4;
+    slot = 0;
+
+blk_chain:
+    next_blk = blk->next[slot];
+    if (next_blk == NULL || next_blk->pc != pc)
+    {
+        next_blk = blk_cache_get(pc,handler,&&blk_end);
+        if (next_blk == NULL)
+            goto eng_exit;
+        // 翻译过程中清空了缓存时，blk已经失效，不能再链接
+        if (blk_cache_gen() == gen) {
+            blk->next[slot] = next_blk;
+            blk_cache_chained();
+        }
+        gen = blk_cache_gen();
+        pred_sync();
+    }
+    blk = next_blk;
+    goto blk_enter;
+
+blk_jump:
+    // d为已经执行的jal或jalr，e_st->curr_pc为其地址
+    if (d->id == INST_JAL) {
+        if (is_link(d->rd))
+            ras_push(e_st->curr_pc + 4,blk);
+        goto blk_chain;
+    }
+    {
+        Block *caller = NULL;
+        if (is_link(d->rs1) && d->rd != d->rs1) {
+            // 函数返回，预测正确时通过调用者的next[0]进入返回地址处的基本块
+            RasEntry *ent = ras_pop();
+            if (ent != NULL && ent->pc == pc) {
+                bc_stat->ras_hit += 1;
+                caller = ent->caller;
+                next_blk = caller->next[0];
+            }
+            else
+                bc_stat->ras_miss += 1;
+        }
+        if (caller == NULL) {
+            next_blk = ibtc[ibtc_idx(pc)];
+            if (next_blk != NULL && next_blk->pc == pc)
+                bc_stat->ibtc_hit += 1;
+            else
+                bc_stat->ibtc_miss += 1;
+        }
+        if (is_link(d->rd))
+            ras_push(e_st->curr_pc + 4,blk);
+        if (next_blk == NULL || next_blk->pc != pc)
+        {
+            next_blk = blk_cache_get(pc,handler,&&blk_end);
+            if (next_blk == NULL)
+                goto eng_exit;
+            if (blk_cache_gen() == gen) {
+                if (caller != NULL)
+                    caller->next[0] = next_blk;
+                else
+                    ibtc[ibtc_idx(pc)] = next_blk;
+            }
+            gen = blk_cache_gen();
+            pred_sync();
+        }
+        blk = next_blk;
+        goto blk_enter;
+    }
+
+// 退休当前指令，执行基本块中的下一条指令
+#define ENG_NEXT()                                                      \
+    do {                                                                \
+        retired += 1;                                                   \
+        pc += 4;                                                        \
+        op += 1;                                                        \
+        d = &(op->dec);                                                 \
+        goto *(op->handler);                                            \
+    } while (0)
+
+// 融合的两条指令在同一个基本块中，执行数量已经在进入基本块时检查过
+#define ENG_FUSED()                                                     \
+    do {                                                                \
+        retired += 1;                                                   \
+        pc += 4;                                                        \
+        op += 1;                                                        \
+        d = &(op->dec);                                                 \
+    } while (0)
+
+// 写到已经翻译的代码或者执行fence.i后，当前基本块可能已经失效，需要退出引擎
+#define ENG_STORE()                                                     \
+    do {                                                                \
+        if (blk_cache_gen() != gen) {                                   \
+            retired += 1;                                               \
+            e_st->curr_pc = pc;                                         \
+            pc += 4;                                                    \
+            goto eng_exit;                                              \
+        }                                                               \
+        ENG_NEXT();                                                     \
+    } while (0)
+
+// 分支是基本块的最后一条指令，根据方向选择链接的后继
+#define ENG_BRANCH()                                                    \
+    do {                                                                \
+        if (e_st->exception)                                            \
+            goto eng_trap;                                              \
+        retired += 1;                                                   \
+        e_st->curr_pc = pc;                                             \
+        slot = (next_pc != pc + 4);                                     \
+        blk->br_cnt += 1;                                               \
+        blk->br_taken_cnt += slot;                                      \
+        pc = next_pc;                                                   \
+        goto blk_chain;                                                 \
+    } while (0)
+
+// 跳转指令，除了链接后继之外还要维护返回地址栈和间接跳转目标缓存
+#define ENG_JUMP()                                                      \
+    do {                                                                \
+        if (e_st->exception)                                            \
+            goto eng_trap;                                              \
+        retired += 1;                                                   \
+        e_st->curr_pc = pc;                                             \
+        slot = (next_pc != pc + 4);                                     \
+        blk->br_cnt += 1;                                               \
+        blk->br_taken_cnt += slot;                                      \
+        pc = next_pc;                                                   \
+        goto blk_jump;                                                  \
+    } while (0)
+
+#include "engine_body.h"
+
+#undef ENG_NEXT
+#undef ENG_STORE
+#undef ENG_BRANCH
+#undef ENG_JUMP
+#undef ENG_FUSED
+}
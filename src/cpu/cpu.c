@@ -24,12 +24,18 @@ SOFTWARE.
 
 #include <stdint.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "cpu_config.h"
 #include "cpu.h"
 #include "front_end.h"
 #include "back_end.h"
 #include "cpu_glb.h"
+#include "dec_cache.h"
+#include "block_cache.h"
+#include "jit_x64.h"
+#include "lockstep.h"
+#include "hle.h"
 #include "../include/color.h"
 
 // ----------------------------------------------
@@ -70,77 +76,164 @@ static void cpu_init(uint64_t entry_addr,uint8_t self_test)
 }
 
 static CPUParam cpu_params;
-void* cpu_run(void* param){
-    cpu_params = *((CPUParam*)param);
-    cpu_init(cpu_params.entry_addr,cpu_params.self_test);
-    ExeStatus *e_st = read_exe_st();
-    *(cpu_params.start_time) = clock();
-    while (1)
-    {
-        // TimeOut 保护
-        if(e_st->self_test && iid == cpu_params.TIME_OUT){
-            *(cpu_params.end_time) = clock();
-            printf("**********" L_RED "TIMEOUT" NONE "**********\n");
-            printf("TIMEOUT Instruction Number: %lu\n",iid);
-            printf("current PC: %lx\n",(uint64_t)(e_st->curr_pc));
-            break;
-        }
 
-        volatile uint8_t stop_value = *(cpu_params.cpu_exit);
-        if (stop_value)
-        {
-            *(cpu_params.end_time) = clock();
-            printf("CPU exit!\n");
-            break;
-        }
+static void self_test_timeout(ExeStatus *e_st){
+    *(cpu_params.end_time) = clock();
+    printf("**********" L_RED "TIMEOUT" NONE "**********\n");
+    printf("TIMEOUT Instruction Number: %lu\n",iid);
+    printf("current PC: %lx\n",(uint64_t)(e_st->curr_pc));
+}
 
+// lockstep的下一个比较点
+static uint64_t ls_next;
 
-        set_cpu_mode(e_st->next_mode);
-        // Front End process
-        update_fetch_param();
-        instruction_fetch(&fetch_param,fetch_data_buf);
-        // Back End process
-        update_exe_param();
-        instruction_execute(&exe_param);
-
-        if (e_st->exit != 0){
-            *(cpu_params.end_time) = clock();
-            printf("Virtual Machine Exit!\n");
-            iid +=1;
-            if (e_st->self_test)
-            {
-                printf("Self Test Exit! Total Instruction Number: %lu\n",iid);
-                printf("current PC: %lx\n",(uint64_t)(e_st->curr_pc));
-                printf("*******************************\n");
-                FILE* st_fd = fopen("./self_test_result.log","w");
-                if (e_st->exit == 1)
-                {
-                    printf("**********" L_BLUE " TEST PASS " NONE "**********\n");
-                    fprintf(st_fd,"1");
-                }
-                else if(e_st->exit == 2){
-                    printf("**********" L_RED " TEST FAIL " NONE "**********\n");
-                    fprintf(st_fd,"0");
-                }
-                printf("*******************************\n");
-                fclose(st_fd);
-            }
-            break;
-        }
+// 已经执行了done条指令，下一条指令的地址为next_pc
+static void lockstep_next(uint64_t done, uint64_t next_pc){
+    if (cpu_params.lockstep == LOCKSTEP_BLOCK)
+        ls_next = done + lockstep_blk_len(next_pc);
+    else
+        ls_next = done + cpu_params.lockstep;
+}
 
-        if (cpu_params.tpc_fd != NULL) // 表明有打开的trace log文件，使能了trace pc的功能
+// 本轮执行了exe_num条指令，到达比较点或者退出时与参考进程比较
+// 出现差异时返回非0
+static int lockstep_point(ExeStatus *e_st, uint64_t exe_num){
+    ArchState st;
+    if (iid + exe_num != ls_next && e_st->exit == 0)
+        return 0;
+    arch_state_read(&st,iid + exe_num,e_st->next_pc,e_st->next_mode,e_st->exit);
+    if (lockstep_check(&st) != 0)
+        return 1;
+    lockstep_next(iid + exe_num,e_st->next_pc);
+    return 0;
+}
+
+static void self_test_finish(ExeStatus *e_st){
+    printf("Self Test Exit! Total Instruction Number: %lu\n",iid);
+    printf("current PC: %lx\n",(uint64_t)(e_st->curr_pc));
+    printf("*******************************\n");
+    FILE* st_fd = fopen("./self_test_result.log","w");
+    if (e_st->exit == 1)
+    {
+        printf("**********" L_BLUE " TEST PASS " NONE "**********\n");
+        fprintf(st_fd,"1");
+    }
+    else if(e_st->exit == 2){
+        printf("**********" L_RED " TEST FAIL " NONE "**********\n");
+        fprintf(st_fd,"0");
+    }
+    printf("*******************************\n");
+    fclose(st_fd);
+}
+
+// 执行循环的各个变体，由cpu_run()在开始时选择一次
+// 普通运行，没有任何额外的检查
+#define LOOP_NAME       loop_plain
+#define LOOP_INTERP     interp_plain
+#define LOOP_SELF_TEST  0
+#define LOOP_TRACE      0
+#define LOOP_CHECK      0
+#define LOOP_LOCKSTEP   0
+#include "cpu_loop.h"
+
+// 自测模式，只在每一段的边界检查超时
+#define LOOP_NAME       loop_self_test
+#define LOOP_INTERP     interp_self_test
+#define LOOP_SELF_TEST  1
+#define LOOP_TRACE      0
+#define LOOP_CHECK      0
+#define LOOP_LOCKSTEP   0
+#include "cpu_loop.h"
+
+// trace PC，逐条执行并记录
+#define LOOP_NAME       loop_trace
+#define LOOP_INTERP     interp_trace
+#define LOOP_SELF_TEST  (cpu_params.self_test)
+#define LOOP_TRACE      1
+#define LOOP_CHECK      (cpu_params.instrument)
+#define LOOP_LOCKSTEP   0
+#include "cpu_loop.h"
+
+// 插桩运行，逐条执行并检查不变量
+#define LOOP_NAME       loop_instrument
+#define LOOP_INTERP     interp_instrument
+#define LOOP_SELF_TEST  (cpu_params.self_test)
+#define LOOP_TRACE      0
+#define LOOP_CHECK      1
+#define LOOP_LOCKSTEP   0
+#include "cpu_loop.h"
+
+// lockstep，在比较点与参考进程比较状态
+#define LOOP_NAME       loop_lockstep
+#define LOOP_INTERP     interp_lockstep
+#define LOOP_SELF_TEST  1
+#define LOOP_TRACE      0
+#define LOOP_CHECK      0
+#define LOOP_LOCKSTEP   1
+#include "cpu_loop.h"
+
+// 参考进程的执行循环，只使用interp引擎，执行到当前进程给出的比较点后回复状态
+static void loop_lockstep_ref(){
+    ExeStatus *e_st = read_exe_st();
+    uint64_t target;
+    uint64_t budget;
+    ArchState st;
+    while (lockstep_wait(&target) == 0)
+    {
+        while (iid < target && e_st->exit == 0)
         {
-            if (fprintf(cpu_params.tpc_fd,"0x%x\n",(MXLEN_T)pc) < 0)
-            {
-                printf("Warning! found error during writing log file of Trace PC");
-            }
+            set_cpu_mode(e_st->next_mode);
+            budget = (target - iid < ENGINE_SLICE) ? target - iid : ENGINE_SLICE;
+            iid += interp_lockstep(budget);
+            if (e_st->exit == 0)
+                pc = e_st->next_pc;
         }
+        arch_state_read(&st,iid,e_st->next_pc,e_st->next_mode,e_st->exit);
+        lockstep_reply(&st);
+    }
+}
 
-
-        // prepare for next instruction
-        iid +=1;
-        pc = e_st->next_pc;
+void* cpu_run(void* param){
+    cpu_params = *((CPUParam*)param);
+    ExeEngine engine = cpu_params.engine;
+    // trace PC和插桩需要逐条执行，只能使用逐条执行的方式
+    if (cpu_params.tpc_fd != NULL || cpu_params.instrument)
+        engine = ENGINE_INTERP;
+    cpu_init(cpu_params.entry_addr,cpu_params.self_test);
+    // 在创建JIT线程和基本块缓存之前fork，参考进程只需要interp引擎
+    if (cpu_params.lockstep != 0) {
+        int ls_role = lockstep_fork();
+        if (ls_role == 1) {
+            loop_lockstep_ref();
+            _exit(0);
+        }
+        if (ls_role < 0) {
+            printf("Warning! Cannot create the lockstep reference process, lockstep is disabled\n");
+            cpu_params.lockstep = 0;
+        }
+        else
+            lockstep_next(0,pc);
+    }
+    if (engine == ENGINE_JIT && jit_init(cpu_params.jit_hot,cpu_params.jit_opt_hot,cpu_params.jit_threads) != 0) {
+        printf("Warning! JIT is not available on this host, use the block engine\n");
+        engine = ENGINE_BLOCK;
     }
+    if (engine == ENGINE_BLOCK || engine == ENGINE_JIT)
+        blk_cache_init();
+    *(cpu_params.start_time) = clock();
+    if (cpu_params.tpc_fd != NULL)
+        loop_trace(engine);
+    else if (cpu_params.instrument)
+        loop_instrument(engine);
+    else if (cpu_params.lockstep != 0)
+        loop_lockstep(engine);
+    else if (cpu_params.self_test)
+        loop_self_test(engine);
+    else
+        loop_plain(engine);
+    lockstep_end();
+    // 内存释放之前保存译码结果，供下一次运行使用
+    dec_cache_persist();
 }
 
 uint64_t get_iid()
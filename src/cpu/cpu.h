@@ -29,12 +29,26 @@ SOFTWARE.
 #include <stdio.h>
 #include <time.h>
 
+// 执行引擎
+typedef enum {
+    ENGINE_INTERP   = 0, // 逐条指令取指和执行
+    ENGINE_THREADED = 1, // 基于computed goto的threaded code
+    ENGINE_BLOCK    = 2, // 基本块翻译缓存，基本块之间直接链接
+    ENGINE_JIT      = 3  // 在基本块引擎的基础上，将热点基本块编译为x86-64本地代码
+} ExeEngine;
+
 typedef struct cpu_param_t
 {
     uint64_t TIME_OUT;
     uint64_t entry_addr;
     uint8_t self_test;
+    ExeEngine engine;  // 执行引擎
+    uint32_t jit_hot;     // 进入JIT baseline层的执行次数
+    uint32_t jit_opt_hot; // 进入JIT优化层的执行次数
+    uint32_t jit_threads; // JIT后台编译线程数
     FILE* tpc_fd;
+    uint8_t instrument;   // 逐条检查x0等不变量
+    uint64_t lockstep;    // lockstep比较间隔的指令数，LOCKSTEP_BLOCK为每个基本块，0表示关闭
     uint8_t* cpu_exit;
     clock_t* start_time;
     clock_t* end_time;
@@ -61,5 +61,9 @@ typedef uint8_t FetchWidth;
 
 #define FETCH_NUM 1
 
+// 各个执行引擎每次最多连续执行的指令数
+// 每执行完一段，回到cpu_run()检查退出、超时和模式切换
+#define ENGINE_SLICE 4096
+
 #endif //__CPU_CONFIG_H__
 
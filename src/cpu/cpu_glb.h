@@ -52,24 +52,24 @@ typedef struct fetch_status
     uint32_t err_id;
 } FetchStatus;
 
-typedef struct exception_cause_t
+// 异常号，与mcause中的Exception Code一致
+typedef enum exception_code_e
 {
-    uint8_t instruction_address_misaligned;
-    uint8_t instruction_access_fault;
-    uint8_t illegal_instruction;
-    uint8_t ifetch_breakpoint;
-    uint8_t ecall_breakpoint;
-    uint8_t lsu_breakpoint;
-    uint8_t load_access_fault;
-    uint8_t store_amo_address_misaligned;
-    uint8_t store_access_fault;
-    uint8_t ecall_from_u;
-    uint8_t ecall_from_s;
-    uint8_t ecall_from_m;
-    uint8_t instruction_page_fault;
-    uint8_t load_page_fault;
-    uint8_t store_amo_page_fault;
-} ECause;
+    EXC_INST_MISALIGNED     = 0,
+    EXC_INST_ACCESS_FAULT   = 1,
+    EXC_ILLEGAL_INST        = 2,
+    EXC_BREAKPOINT          = 3,
+    EXC_LOAD_MISALIGNED     = 4,
+    EXC_LOAD_ACCESS_FAULT   = 5,
+    EXC_STORE_MISALIGNED    = 6,
+    EXC_STORE_ACCESS_FAULT  = 7,
+    EXC_ECALL_U             = 8,
+    EXC_ECALL_S             = 9,
+    EXC_ECALL_M             = 11,
+    EXC_INST_PAGE_FAULT     = 12,
+    EXC_LOAD_PAGE_FAULT     = 13,
+    EXC_STORE_PAGE_FAULT    = 15
+} ExcCode;
 
 typedef struct execute_status
 {
@@ -84,7 +84,8 @@ typedef struct execute_status
     CPUMode next_mode; // 用于切换模式
     uint8_t branch; // 用于分支跳转
     uint8_t exception; //用于处理异常
-    ECause ecause;
+    uint8_t ecause;    // 异常号，见ExcCode，一条指令最多产生一个异常
+    MXLEN_T tval;      // 异常的附加信息，trap时写入mtval
     uint8_t interupt; //用于处理中断
     MXLEN_T icause; //中断号
     uint8_t mret; // 用于处理mret指令
@@ -0,0 +1,120 @@
+// cpu_run()的执行循环模板
+// 只能被cpu.c包含，每次包含都会展开一个执行循环的变体，因此不加头文件保护
+// 包含之前需要定义：
+//   LOOP_NAME      执行循环的函数名
+//   LOOP_INTERP    逐条执行的函数名
+//   LOOP_SELF_TEST 自测模式的超时保护和结果输出
+//   LOOP_TRACE     逐条记录PC
+//   LOOP_CHECK     逐条检查x0等不变量
+//   LOOP_LOCKSTEP  在比较点与参考进程比较状态
+// 后四个宏可以是常量，也可以是运行时的表达式
+// 为常量0时，对应的检查在编译时被去掉，不会在热路径上产生开销
+
+// 逐条记录或者检查的变体只使用interp引擎
+#define LOOP_STEP (LOOP_TRACE || LOOP_CHECK)
+
+// 逐条执行，最多执行budget条指令
+// 需要退出或者特权模式发生变化时提前结束，由执行循环切换模式
+static uint64_t LOOP_INTERP(uint64_t budget){
+    ExeStatus *e_st = get_exe_st_ptr();
+    CPUMode curr_mode = get_cpu_mode();
+    uint64_t exe_num = 0;
+    // 没有注册HLE入口时不查表，执行期间不会再注册
+    const int hle_on = hle_num != 0;
+    while (1)
+    {
+        // 注册了HLE入口时，调用由host完成
+        uint8_t hle_hit = hle_on ? hle_lookup(pc) : 0;
+        if (hle_hit == 0 || !hle_execute(pc,hle_hit))
+        {
+            // Front End process
+            update_fetch_param();
+            exe_param.dec_inst = instruction_fetch(&fetch_param,fetch_data_buf);
+            // Back End process
+            update_exe_param();
+            instruction_execute(&exe_param);
+        }
+        exe_num += 1;
+        if (LOOP_CHECK && x0_written())
+            printf("Error! Cannot write value to X0!");
+        // 表明有打开的trace log文件，使能了trace pc的功能
+        // 退出的那条指令不记录
+        if (LOOP_TRACE && e_st->exit == 0)
+        {
+            if (fprintf(cpu_params.tpc_fd,"0x%x\n",(MXLEN_T)pc) < 0)
+            {
+                printf("Warning! found error during writing log file of Trace PC");
+            }
+        }
+        if (exe_num == budget || e_st->exit != 0 || e_st->next_mode != curr_mode)
+            return exe_num;
+        pc = e_st->next_pc;
+    }
+}
+
+static void LOOP_NAME(ExeEngine engine){
+    ExeStatus *e_st = read_exe_st();
+    uint64_t exe_num;  // 本轮执行的指令数
+    uint64_t budget;   // 本轮最多执行的指令数
+    while (1)
+    {
+        // TimeOut 保护
+        if (LOOP_SELF_TEST && iid == cpu_params.TIME_OUT){
+            self_test_timeout(e_st);
+            break;
+        }
+
+        volatile uint8_t stop_value = *(cpu_params.cpu_exit);
+        if (stop_value)
+        {
+            *(cpu_params.end_time) = clock();
+            printf("CPU exit!\n");
+            break;
+        }
+
+        // 超时、退出和模式切换的检查只在每一段的边界进行
+        set_cpu_mode(e_st->next_mode);
+        budget = ENGINE_SLICE;
+        // 自测模式下不能越过TIMEOUT
+        if (LOOP_SELF_TEST && cpu_params.TIME_OUT - iid < budget)
+            budget = cpu_params.TIME_OUT - iid;
+        // lockstep模式下不能越过下一个比较点
+        if (LOOP_LOCKSTEP && ls_next - iid < budget)
+            budget = ls_next - iid;
+        exe_num = 0;
+        if (!LOOP_STEP && (engine == ENGINE_BLOCK || engine == ENGINE_JIT))
+            exe_num = block_execute(pc,budget);
+        else if (!LOOP_STEP && engine == ENGINE_THREADED)
+            exe_num = threaded_execute(pc,budget);
+        if (exe_num == 0)
+            // 有中断需要处理，或者当前指令不能被缓存时，逐条执行一条后回到引擎
+            exe_num = LOOP_INTERP((LOOP_STEP || engine == ENGINE_INTERP) ? budget : 1);
+
+        if (LOOP_LOCKSTEP && lockstep_point(e_st,exe_num) != 0){
+            *(cpu_params.end_time) = clock();
+            iid += exe_num;
+            break;
+        }
+
+        if (e_st->exit != 0){
+            *(cpu_params.end_time) = clock();
+            printf("Virtual Machine Exit!\n");
+            iid += exe_num;
+            if (LOOP_SELF_TEST)
+                self_test_finish(e_st);
+            break;
+        }
+
+        // prepare for next instruction
+        iid += exe_num;
+        pc = e_st->next_pc;
+    }
+}
+
+#undef LOOP_STEP
+#undef LOOP_NAME
+#undef LOOP_INTERP
+#undef LOOP_SELF_TEST
+#undef LOOP_TRACE
+#undef LOOP_CHECK
+#undef LOOP_LOCKSTEP
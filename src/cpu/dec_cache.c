@@ -0,0 +1,371 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "dec_cache.h"
+#include "predecode.h"
+#include "disk_cache.h"
+#include "../dev/memory.h"
+#include "../dev/mem_pool.h"
+#include "../dev/dev_config.h"
+#include "../include/comm.h"
+
+static uint8_t dec_cache_en;
+static DecPage* dec_pages [DEC_CACHE_SETS];
+static DecCacheStat dec_stat;
+
+static inline uint32_t dec_set_idx(uint64_t page_tag){
+    return (uint32_t)((page_tag / DEC_PAGE_SIZE) & (DEC_CACHE_SETS - 1));
+}
+
+static inline uint32_t dec_inst_idx(uint64_t pc){
+    return (uint32_t)(MOD(pc,DEC_PAGE_SIZE) >> 2);
+}
+
+void dec_cache_init(uint8_t enable)
+{
+    dec_cache_en = enable;
+    for (uint32_t i = 0; i < DEC_CACHE_SETS; i++)
+    {
+        dec_pages[i] = NULL;
+    }
+    memset(&dec_stat, 0, sizeof(DecCacheStat));
+}
+
+void dec_cache_free()
+{
+    for (uint32_t i = 0; i < DEC_CACHE_SETS; i++)
+    {
+        free(dec_pages[i]);
+        dec_pages[i] = NULL;
+    }
+}
+
+DecInst* dec_cache_lkup(uint64_t pc)
+{
+    uint64_t page_tag = ROUND(pc,DEC_PAGE_SIZE);
+    DecPage *page = dec_pages[dec_set_idx(page_tag)];
+
+    if (page != NULL && page->tag == page_tag)
+    {
+        DecInst *dec = &(page->inst[dec_inst_idx(pc)]);
+        if (dec->id != INST_NONE)
+        {
+            dec_stat.hit += 1;
+            return dec;
+        }
+    }
+    if (dec_cache_en)
+        dec_stat.miss += 1;
+    return NULL;
+}
+
+static void dec_fuse(DecInst *first, DecInst *second){
+    first->hid = fuse_pair(first,second);
+    if (first->hid != first->id)
+        dec_stat.fuse += 1;
+}
+
+// 页第一次装入时，从磁盘读取之前的译码结果，并重新检查融合
+static void dec_page_load(DecPage *page){
+    page->disk_key = disk_cache_load(page->tag,page->inst);
+    page->disk_dirty = 0;
+    for (uint32_t i = 0; i < DEC_PAGE_INST; i++)
+    {
+        if (page->inst[i].id == INST_NONE)
+            continue;
+        if (i < DEC_PAGE_INST - 1 && page->inst[i + 1].id != INST_NONE)
+            dec_fuse(&(page->inst[i]),&(page->inst[i + 1]));
+        else
+            page->inst[i].hid = page->inst[i].id;
+    }
+}
+
+static void dec_page_persist(DecPage *page){
+    if (page->disk_dirty)
+        disk_cache_store(page->disk_key,page->inst);
+    page->disk_dirty = 0;
+}
+
+DecInst* dec_cache_fill(uint64_t pc, uint32_t inst)
+{
+    if (!dec_cache_en)
+        return NULL;
+
+    // 不对齐的PC无法放入缓存
+    if (MOD(pc,4) != 0)
+        return NULL;
+
+    uint64_t page_tag = ROUND(pc,DEC_PAGE_SIZE);
+    uint32_t set = dec_set_idx(page_tag);
+    DecPage *page = dec_pages[set];
+
+    if (page == NULL)
+    {
+        page = (DecPage*)malloc(sizeof(DecPage));
+        if (page == NULL)
+            return NULL;
+        memset(page, 0, sizeof(DecPage));
+        page->tag = page_tag;
+        dec_pages[set] = page;
+        dec_page_load(page);
+        // 写入这一页时需要使译码结果失效，不能再经过写TLB
+        tlb_flush_wr(page_tag);
+    }
+    else if (page->tag != page_tag)
+    {
+        // 冲突替换，整页清空
+        dec_page_persist(page);
+        memset(page->inst, 0, sizeof(page->inst));
+        page->tag = page_tag;
+        dec_stat.evict += 1;
+        dec_page_load(page);
+        tlb_flush_wr(page_tag);
+    }
+
+    uint32_t idx = dec_inst_idx(pc);
+    DecInst *dec = &(page->inst[idx]);
+    // 已经从磁盘装入
+    if (dec->id != INST_NONE && dec->inst == inst)
+        return dec;
+    predecode(inst,dec);
+    page->disk_dirty = 1;
+
+    // 与同一页中已经译码的前后指令融合
+    if (idx > 0 && page->inst[idx - 1].id != INST_NONE)
+        dec_fuse(&(page->inst[idx - 1]),dec);
+    if (idx < DEC_PAGE_INST - 1 && page->inst[idx + 1].id != INST_NONE)
+        dec_fuse(dec,&(page->inst[idx + 1]));
+    return dec;
+}
+
+static void dec_page_inval(uint64_t page_tag, uint32_t start_idx, uint32_t end_idx){
+    DecPage *page = dec_pages[dec_set_idx(page_tag)];
+    if (page == NULL || page->tag != page_tag)
+        return;
+
+    for (uint32_t i = start_idx; i <= end_idx; i++)
+    {
+        if (page->inst[i].id != INST_NONE)
+        {
+            page->inst[i].id = INST_NONE;
+            page->inst[i].hid = INST_NONE;
+            dec_stat.inval += 1;
+        }
+    }
+    // 前一条指令不能再和失效的指令融合
+    if (start_idx > 0)
+        page->inst[start_idx - 1].hid = page->inst[start_idx - 1].id;
+}
+
+void dec_cache_inval(uint64_t addr, uint8_t byte_num)
+{
+    if (byte_num == 0)
+        return;
+
+    uint64_t end_addr  = addr + byte_num - 1;
+    uint64_t start_tag = ROUND(addr,DEC_PAGE_SIZE);
+    uint64_t end_tag   = ROUND(end_addr,DEC_PAGE_SIZE);
+
+    if (start_tag == end_tag)
+    {
+        dec_page_inval(start_tag,dec_inst_idx(addr),dec_inst_idx(end_addr));
+    }
+    else {
+        // 跨页写入
+        dec_page_inval(start_tag,dec_inst_idx(addr),DEC_PAGE_INST - 1);
+        dec_page_inval(end_tag,0,dec_inst_idx(end_addr));
+    }
+}
+
+void dec_cache_fence()
+{
+    for (uint32_t s = 0; s < DEC_CACHE_SETS; s++)
+    {
+        DecPage *page = dec_pages[s];
+        if (page == NULL)
+            continue;
+        const uint8_t *mem = mem_pool_lkup(page->tag);
+        for (uint32_t i = 0; i < DEC_PAGE_INST; i++)
+        {
+            uint32_t word;
+            if (page->inst[i].id == INST_NONE)
+                continue;
+            memcpy(&word,mem + 4 * i,4);
+            if (page->inst[i].inst != word)
+                dec_page_inval(page->tag,i,i);
+        }
+    }
+}
+
+uint8_t dec_cache_has_page(uint64_t addr)
+{
+    uint64_t page_tag = ROUND(addr,DEC_PAGE_SIZE);
+    DecPage *page = dec_pages[dec_set_idx(page_tag)];
+    return (page != NULL && page->tag == page_tag);
+}
+
+// ----------------------------------------------
+// 预译码
+// ----------------------------------------------
+typedef struct dec_pre_task_t
+{
+    DecPage       **page;       // 所有线程共享的页
+    const uint8_t **mem;        // 页在内存池中的地址
+    uint32_t        start;      // 本线程处理的页[start, end)
+    uint32_t        end;
+    uint64_t        fuse;
+} DecPreTask;
+
+static void* dec_pre_worker(void *arg){
+    DecPreTask *task = (DecPreTask*)arg;
+    for (uint32_t k = task->start; k < task->end; k++)
+    {
+        DecPage *page = task->page[k];
+        for (uint32_t i = 0; i < DEC_PAGE_INST; i++)
+        {
+            uint32_t inst;
+            memcpy(&inst,task->mem[k] + 4 * i,4);
+            predecode(inst,&(page->inst[i]));
+        }
+        for (uint32_t i = 0; i < DEC_PAGE_INST; i++)
+        {
+            DecInst *dec = &(page->inst[i]);
+            if (i < DEC_PAGE_INST - 1) {
+                dec->hid = fuse_pair(dec,&(page->inst[i + 1]));
+                task->fuse += (dec->hid != dec->id);
+            }
+        }
+    }
+    return NULL;
+}
+
+uint32_t dec_cache_preload(const uint64_t *base, const uint64_t *size, uint32_t seg_num, uint32_t threads)
+{
+    if (!dec_cache_en || threads == 0)
+        return 0;
+
+    // 收集需要预译码的页，每组只装入一页
+    DecPage *page[DEC_CACHE_SETS];
+    const uint8_t *mem[DEC_CACHE_SETS];
+    uint8_t used[DEC_CACHE_SETS] = {0};
+    uint32_t page_num = 0;
+    for (uint32_t s = 0; s < seg_num; s++)
+    {
+        for (uint64_t tag = ROUND(base[s],DEC_PAGE_SIZE); tag < base[s] + size[s]; tag += DEC_PAGE_SIZE)
+        {
+            uint32_t set = dec_set_idx(tag);
+            if (tag < DRAM_BASE || tag > DRAM_END)
+                continue;
+            // 组已经被可执行段中更前面的页占用，该页在第一次执行时再译码
+            if (used[set]) {
+                dec_stat.preload_skip += 1;
+                continue;
+            }
+            page[page_num] = (DecPage*)calloc(1,sizeof(DecPage));
+            if (page[page_num] == NULL)
+                continue;
+            page[page_num]->tag = tag;
+            used[set] = 1;
+            page_num += 1;
+        }
+    }
+    if (page_num == 0)
+        return 0;
+    // 内存池不是线程安全的，在启动线程之前查询
+    for (uint32_t k = 0; k < page_num; k++)
+        mem[k] = mem_pool_lkup(page[k]->tag);
+
+    if (threads > page_num)
+        threads = page_num;
+    DecPreTask *task = (DecPreTask*)calloc(threads,sizeof(DecPreTask));
+    pthread_t *tid = (pthread_t*)calloc(threads,sizeof(pthread_t));
+    uint8_t *started = (uint8_t*)calloc(threads,1);
+    if (task == NULL || tid == NULL || started == NULL) {
+        free(task);
+        free(tid);
+        free(started);
+        for (uint32_t k = 0; k < page_num; k++)
+            free(page[k]);
+        return 0;
+    }
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        task[t].page = page;
+        task[t].mem = mem;
+        task[t].start = (uint32_t)((uint64_t)page_num * t / threads);
+        task[t].end = (uint32_t)((uint64_t)page_num * (t + 1) / threads);
+        // 第一个任务由当前线程执行，线程创建失败时也由当前线程执行
+        if (t > 0)
+            started[t] = (pthread_create(&tid[t],NULL,dec_pre_worker,&task[t]) == 0);
+    }
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        if (!started[t])
+            dec_pre_worker(&task[t]);
+    }
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        if (started[t])
+            pthread_join(tid[t],NULL);
+        dec_stat.fuse += task[t].fuse;
+    }
+    free(task);
+    free(tid);
+    free(started);
+
+    for (uint32_t k = 0; k < page_num; k++)
+    {
+        uint32_t set = dec_set_idx(page[k]->tag);
+        if (dec_pages[set] != NULL)
+            dec_page_persist(dec_pages[set]);
+        free(dec_pages[set]);
+        // 整页都是新译码的结果，磁盘中还没有时需要保存
+        page[k]->disk_key = disk_cache_key(page[k]->tag);
+        page[k]->disk_dirty = (page[k]->disk_key != 0 && !disk_cache_stored(page[k]->disk_key));
+        dec_pages[set] = page[k];
+        tlb_flush_wr(page[k]->tag);
+    }
+    dec_stat.preload += page_num;
+    return page_num;
+}
+
+void dec_cache_persist()
+{
+    for (uint32_t i = 0; i < DEC_CACHE_SETS; i++)
+    {
+        if (dec_pages[i] != NULL)
+            dec_page_persist(dec_pages[i]);
+    }
+    disk_cache_evict();
+}
+
+DecCacheStat* get_dec_cache_stat()
+{
+    return &dec_stat;
+}
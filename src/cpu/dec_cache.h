@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// 译码缓存
+// 以guest的页为单位缓存预译码的结果，循环中的指令命中缓存后可以跳过取指和译码
+// 每页对应一个DecPage，页中每个4byte对齐的位置对应一个DecInst表项
+// 对缓存页所在地址的写操作会使对应的表项失效
+// 同一页中相邻的两条指令都完成译码后，会检查能否融合，结果记录在前一条指令的hid中
+// 使能磁盘缓存时，页第一次装入时从磁盘读取之前的译码结果，见disk_cache.h
+// 加载程序后，可以由多个线程对可执行段的所有页进行预译码，第一次执行时就能命中
+
+#ifndef __DEC_CACHE_H__
+    #define __DEC_CACHE_H__
+
+#include <stdint.h>
+#include "predecode.h"
+
+#define DEC_PAGE_SIZE   4096 // 与内存池的页大小保持一致
+#define DEC_PAGE_INST   (DEC_PAGE_SIZE / 4)
+#define DEC_CACHE_SETS  256  // 直接映射，最多缓存1MB的代码
+
+typedef struct dec_page_t
+{
+    uint64_t tag;   // 页的首地址
+    uint64_t disk_key;  // 装入时页内容的键，0表示不保存到磁盘
+    uint8_t  disk_dirty;// 装入后有新的表项完成译码
+    DecInst  inst[DEC_PAGE_INST];
+} DecPage;
+
+typedef struct dec_cache_stat_t
+{
+    uint64_t hit;   // 命中次数
+    uint64_t miss;  // 缺失次数
+    uint64_t inval; // 因写操作失效的表项数
+    uint64_t evict; // 因冲突被替换的页数
+    uint64_t fuse;  // 融合的指令对数
+    uint64_t preload;   // 预译码的页数
+    uint64_t preload_skip;  // 可执行段中因为组已经被占用没有预译码的页数
+} DecCacheStat;
+
+// 初始化译码缓存
+// enable为0时关闭缓存，所有查询都返回缺失
+void dec_cache_init(uint8_t enable);
+void dec_cache_free();
+
+// 查询pc对应的译码结果
+// 命中返回表项，缺失返回NULL
+DecInst* dec_cache_lkup(uint64_t pc);
+
+// 对取到的指令进行译码并填入缓存
+// 返回填入的表项，缓存关闭时返回NULL
+DecInst* dec_cache_fill(uint64_t pc, uint32_t inst);
+
+// 地址[addr, addr + byte_num)被写入，使覆盖到的表项失效
+void dec_cache_inval(uint64_t addr, uint8_t byte_num);
+
+// fence.i：逐条比较缓存中的指令与内存中的内容，使不一致的表项失效
+// 用于没有经过store写入的代码，例如设备或者host直接写入的内存
+void dec_cache_fence();
+
+// addr所在的页是否在缓存中，批量写入内存之前用来判断是否需要逐个表项失效
+uint8_t dec_cache_has_page(uint64_t addr);
+
+// 使用threads个线程对seg_num个段[base[i], base[i] + size[i])中的所有页进行预译码
+// 只处理DRAM中的页，映射到同一组的页只装入第一个，必须在CPU开始执行之前调用
+// 返回预译码的页数
+uint32_t dec_cache_preload(const uint64_t *base, const uint64_t *size, uint32_t seg_num, uint32_t threads);
+
+// 将有新表项的页保存到磁盘缓存
+void dec_cache_persist();
+
+DecCacheStat* get_dec_cache_stat();
+
+#endif //__DEC_CACHE_H__
@@ -0,0 +1,221 @@
+// 由 misc/python/decode.py 根据 misc/rv32_dec.toml 生成，不要手动修改
+// 只能被predecode.c包含
+
+#ifndef __DEC_TABLE_H__
+    #define __DEC_TABLE_H__
+
+#include <stdint.h>
+#include "predecode.h"
+
+#define DEC_F7_NUM  4    // func7的分类数
+#define DEC_MATCH   0x80 // 表项需要继续查匹配表，低位为匹配组的编号
+
+typedef struct dec_match_t
+{
+    uint32_t mask;
+    uint32_t match;
+    uint8_t  id;
+} DecMatch;
+
+typedef struct dec_match_grp_t
+{
+    uint8_t first;  // 在dec_match_tbl中的起始位置
+    uint8_t num;
+    uint8_t dflt;   // 都不匹配时的结果
+} DecMatchGrp;
+
+// 立即数的拼接，没有立即数的指令与I-type一致
+static inline int32_t dec_imm(uint32_t inst){
+    uint8_t func3 = (inst >> 12) & 0b111;
+    switch ((inst >> 2) & 0b11111)
+    {
+    case 0b00100:
+        if ((0b00100010 >> func3) & 1) // shamt = inst[24:20]
+            return (int32_t)(((inst & 0b00000001111100000000000000000000) >> 20));
+        return ((int32_t)((((inst & 0b11111111111100000000000000000000) >> 20)) << 20) >> 20); // imm = inst[31:20]
+    case 0b00101:
+        return (int32_t)((inst & 0b11111111111111111111000000000000)); // imm = inst[31:12] << 12
+    case 0b01000:
+        return ((int32_t)((((inst & 0b00000000000000000000111110000000) >> 7) |
+           ((inst & 0b11111110000000000000000000000000) >> 20)) << 20) >> 20); // imm = inst[11:7,31:25]
+    case 0b01101:
+        return (int32_t)((inst & 0b11111111111111111111000000000000)); // imm = inst[31:12] << 12
+    case 0b11000:
+        return ((int32_t)((((inst & 0b00000000000000000000111100000000) >> 7) |
+           ((inst & 0b01111110000000000000000000000000) >> 20) |
+           ((inst & 0b00000000000000000000000010000000) << 4) |
+           ((inst & 0b10000000000000000000000000000000) >> 19)) << 19) >> 19); // imm = inst[11:8,30:25,7,31] << 1
+    case 0b11011:
+        return ((int32_t)((((inst & 0b01111111111000000000000000000000) >> 20) |
+           ((inst & 0b00000000000100000000000000000000) >> 9) |
+           (inst & 0b00000000000011111111000000000000) |
+           ((inst & 0b10000000000000000000000000000000) >> 11)) << 11) >> 11); // imm = inst[30:21,20,19:12,31] << 1
+    default:
+        return ((int32_t)((((inst & 0b11111111111100000000000000000000) >> 20)) << 20) >> 20);
+    }
+}
+
+// func7 -> 分类
+static const uint8_t dec_f7_tbl[128] = {
+    [0b0000000] = 1,
+    [0b0000001] = 2,
+    [0b0100000] = 3,
+};
+
+// opcode[6:2] -> 第二级表的编号，0表示非法指令
+static const uint8_t dec_op_tbl[32] = {
+    [0b00000] = 1,
+    [0b00011] = 2,
+    [0b00100] = 3,
+    [0b00101] = 4,
+    [0b01000] = 5,
+    [0b01100] = 6,
+    [0b01101] = 7,
+    [0b11000] = 8,
+    [0b11001] = 9,
+    [0b11011] = 10,
+    [0b11100] = 11,
+};
+
+// 第二级表，由 func3 * DEC_F7_NUM + func7分类 索引
+static const uint8_t dec_sub_tbl[12][32] = {
+    { // 没有定义的opcode
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+    },
+    { // opcode = 0b0000011
+        INST_LB, INST_LB, INST_LB, INST_LB,
+        INST_LH, INST_LH, INST_LH, INST_LH,
+        INST_LW, INST_LW, INST_LW, INST_LW,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_LBU, INST_LBU, INST_LBU, INST_LBU,
+        INST_LHU, INST_LHU, INST_LHU, INST_LHU,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+    },
+    { // opcode = 0b0001111
+        DEC_MATCH | 0, DEC_MATCH | 0, DEC_MATCH | 0, DEC_MATCH | 0,
+        DEC_MATCH | 1, DEC_MATCH | 1, DEC_MATCH | 1, DEC_MATCH | 1,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+    },
+    { // opcode = 0b0010011
+        INST_ADDI, INST_ADDI, INST_ADDI, INST_ADDI,
+        INST_ILLEGAL, INST_SLLI, INST_ILLEGAL, INST_ILLEGAL,
+        INST_SLTI, INST_SLTI, INST_SLTI, INST_SLTI,
+        INST_SLTIU, INST_SLTIU, INST_SLTIU, INST_SLTIU,
+        INST_XORI, INST_XORI, INST_XORI, INST_XORI,
+        INST_ILLEGAL, INST_SRLI, INST_ILLEGAL, INST_SRAI,
+        INST_ORI, INST_ORI, INST_ORI, INST_ORI,
+        INST_ANDI, INST_ANDI, INST_ANDI, INST_ANDI,
+    },
+    { // opcode = 0b0010111
+        INST_AUIPC, INST_AUIPC, INST_AUIPC, INST_AUIPC,
+        INST_AUIPC, INST_AUIPC, INST_AUIPC, INST_AUIPC,
+        INST_AUIPC, INST_AUIPC, INST_AUIPC, INST_AUIPC,
+        INST_AUIPC, INST_AUIPC, INST_AUIPC, INST_AUIPC,
+        INST_AUIPC, INST_AUIPC, INST_AUIPC, INST_AUIPC,
+        INST_AUIPC, INST_AUIPC, INST_AUIPC, INST_AUIPC,
+        INST_AUIPC, INST_AUIPC, INST_AUIPC, INST_AUIPC,
+        INST_AUIPC, INST_AUIPC, INST_AUIPC, INST_AUIPC,
+    },
+    { // opcode = 0b0100011
+        INST_SB, INST_SB, INST_SB, INST_SB,
+        INST_SH, INST_SH, INST_SH, INST_SH,
+        INST_SW, INST_SW, INST_SW, INST_SW,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+    },
+    { // opcode = 0b0110011
+        INST_ILLEGAL, INST_ADD, INST_MUL, INST_SUB,
+        INST_ILLEGAL, INST_SLL, INST_MULH, INST_ILLEGAL,
+        INST_ILLEGAL, INST_SLT, INST_MULHSU, INST_ILLEGAL,
+        INST_ILLEGAL, INST_SLTU, INST_MULHU, INST_ILLEGAL,
+        INST_ILLEGAL, INST_XOR, INST_DIV, INST_ILLEGAL,
+        INST_ILLEGAL, INST_SRL, INST_DIVU, INST_SRA,
+        INST_ILLEGAL, INST_OR, INST_REM, INST_ILLEGAL,
+        INST_ILLEGAL, INST_AND, INST_REMU, INST_ILLEGAL,
+    },
+    { // opcode = 0b0110111
+        INST_LUI, INST_LUI, INST_LUI, INST_LUI,
+        INST_LUI, INST_LUI, INST_LUI, INST_LUI,
+        INST_LUI, INST_LUI, INST_LUI, INST_LUI,
+        INST_LUI, INST_LUI, INST_LUI, INST_LUI,
+        INST_LUI, INST_LUI, INST_LUI, INST_LUI,
+        INST_LUI, INST_LUI, INST_LUI, INST_LUI,
+        INST_LUI, INST_LUI, INST_LUI, INST_LUI,
+        INST_LUI, INST_LUI, INST_LUI, INST_LUI,
+    },
+    { // opcode = 0b1100011
+        INST_BEQ, INST_BEQ, INST_BEQ, INST_BEQ,
+        INST_BNE, INST_BNE, INST_BNE, INST_BNE,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_BLT, INST_BLT, INST_BLT, INST_BLT,
+        INST_BGE, INST_BGE, INST_BGE, INST_BGE,
+        INST_BLTU, INST_BLTU, INST_BLTU, INST_BLTU,
+        INST_BGEU, INST_BGEU, INST_BGEU, INST_BGEU,
+    },
+    { // opcode = 0b1100111
+        INST_JALR, INST_JALR, INST_JALR, INST_JALR,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+    },
+    { // opcode = 0b1101111
+        INST_JAL, INST_JAL, INST_JAL, INST_JAL,
+        INST_JAL, INST_JAL, INST_JAL, INST_JAL,
+        INST_JAL, INST_JAL, INST_JAL, INST_JAL,
+        INST_JAL, INST_JAL, INST_JAL, INST_JAL,
+        INST_JAL, INST_JAL, INST_JAL, INST_JAL,
+        INST_JAL, INST_JAL, INST_JAL, INST_JAL,
+        INST_JAL, INST_JAL, INST_JAL, INST_JAL,
+        INST_JAL, INST_JAL, INST_JAL, INST_JAL,
+    },
+    { // opcode = 0b1110011
+        DEC_MATCH | 2, DEC_MATCH | 2, DEC_MATCH | 2, DEC_MATCH | 2,
+        INST_CSRRW, INST_CSRRW, INST_CSRRW, INST_CSRRW,
+        INST_CSRRS, INST_CSRRS, INST_CSRRS, INST_CSRRS,
+        INST_CSRRC, INST_CSRRC, INST_CSRRC, INST_CSRRC,
+        INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL, INST_ILLEGAL,
+        INST_CSRRWI, INST_CSRRWI, INST_CSRRWI, INST_CSRRWI,
+        INST_CSRRSI, INST_CSRRSI, INST_CSRRSI, INST_CSRRSI,
+        INST_CSRRCI, INST_CSRRCI, INST_CSRRCI, INST_CSRRCI,
+    },
+};
+
+// 匹配表，同一组内约束越多的指令越靠前
+static const DecMatch dec_match_tbl[7] = {
+    {0xffff8f80, 0x83300000, INST_FENCE_TSO},
+    {0xffff8f80, 0x01000000, INST_PAUSE},
+    {0xffff8f80, 0x00000000, INST_FENCE_I},
+    {0xffff8f80, 0x00000000, INST_ECALL},
+    {0xffff8f80, 0x00100000, INST_EBREAK},
+    {0xffff8f80, 0x30200000, INST_MRET},
+    {0xffff8f80, 0x10500000, INST_WFI},
+};
+
+static const DecMatchGrp dec_match_grp[3] = {
+    {0, 2, INST_FENCE},
+    {2, 1, INST_ILLEGAL},
+    {3, 4, INST_NOP},
+};
+
+#endif //__DEC_TABLE_H__
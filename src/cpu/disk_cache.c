@@ -0,0 +1,275 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "disk_cache.h"
+#include "dec_cache.h"
+#include "../dev/mem_pool.h"
+#include "../dev/dev_config.h"
+#include "../include/config.h"
+
+#define DISK_MAGIC      0x43445256  // "VRDC"
+#define DISK_VERSION    1
+#define DISK_SUFFIX     ".dpg"
+#define DISK_TMP_SUFFIX ".tmp"
+#define DISK_TMP_AGE    10          // 秒，更早的临时文件属于写入途中退出的进程
+
+typedef struct disk_page_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t build_id;
+    uint64_t key;
+    DecInst  inst[DEC_PAGE_INST];
+} DiskPage;
+
+typedef struct disk_file_t
+{
+    struct timespec mtime;
+    uint64_t size;
+    char     name[64];
+} DiskFile;
+
+static uint8_t  disk_en;
+static char    *disk_dir;
+static uint64_t disk_cap;
+static uint64_t build_id;
+static DiskPage disk_buf;
+static DiskCacheStat disk_stat;
+
+static uint64_t fnv64(uint64_t h, const uint8_t *data, uint64_t len){
+    for (uint64_t i = 0; i < len; i++)
+        h = (h ^ data[i]) * 0x100000001b3ull;
+    return h;
+}
+
+// 模拟器可执行文件的哈希，DecInst的格式和译码的结果都由可执行文件决定
+static uint64_t get_build_id(){
+    uint64_t h = fnv64(0xcbf29ce484222325ull,(const uint8_t*)PROJECT_VERSION,sizeof(PROJECT_VERSION));
+    uint8_t buf[65536];
+    size_t n;
+    FILE *fp = fopen("/proc/self/exe","rb");
+    if (fp == NULL)
+        return fnv64(h,(const uint8_t*)(__DATE__ __TIME__),sizeof(__DATE__ __TIME__));
+    while ((n = fread(buf,1,sizeof(buf),fp)) > 0)
+        h = fnv64(h,buf,n);
+    fclose(fp);
+    return h;
+}
+
+// 路径被截断时返回非0
+static int disk_path(char *path, size_t size, uint64_t key){
+    int n = snprintf(path,size,"%s/%016lx-%016lx" DISK_SUFFIX,disk_dir,build_id,key);
+    return n < 0 || (size_t)n >= size;
+}
+
+int disk_cache_init(const char *dir, uint64_t cap)
+{
+    memset(&disk_stat,0,sizeof(DiskCacheStat));
+    if (mkdir(dir,0755) != 0) {
+        struct stat st;
+        if (stat(dir,&st) != 0 || !S_ISDIR(st.st_mode)) {
+            printf("Error! Cannot use disk cache directory: %s\n",dir);
+            return 1;
+        }
+    }
+    disk_dir = (char*)malloc(strlen(dir) + 1);
+    strcpy(disk_dir,dir);
+    disk_cap = cap;
+    build_id = get_build_id();
+    disk_en = 1;
+    return 0;
+}
+
+void disk_cache_free()
+{
+    free(disk_dir);
+    disk_dir = NULL;
+    disk_en = 0;
+}
+
+uint64_t disk_cache_key(uint64_t page_tag)
+{
+    if (!disk_en || page_tag < DRAM_BASE || page_tag > DRAM_END)
+        return 0;
+    uint64_t key = fnv64(0xcbf29ce484222325ull,mem_pool_lkup(page_tag),DEC_PAGE_SIZE);
+    // 0表示没有键
+    return (key == 0) ? 1 : key;
+}
+
+int disk_cache_stored(uint64_t key)
+{
+    char path[4096];
+    if (!disk_en || key == 0 || disk_path(path,sizeof(path),key) != 0)
+        return 0;
+    return access(path,F_OK) == 0;
+}
+
+uint64_t disk_cache_load(uint64_t page_tag, DecInst *inst)
+{
+    uint64_t key = disk_cache_key(page_tag);
+    if (key == 0)
+        return 0;
+
+    const uint8_t *mem = mem_pool_lkup(page_tag);
+    char path[4096];
+    if (disk_path(path,sizeof(path),key) != 0)
+        return 0;
+    int fd = open(path,O_RDONLY);
+    if (fd < 0) {
+        disk_stat.miss += 1;
+        return key;
+    }
+    ssize_t n = read(fd,&disk_buf,sizeof(DiskPage));
+    // 更新mtime，作为LRU的使用时间
+    futimens(fd,NULL);
+    close(fd);
+    if (n != (ssize_t)sizeof(DiskPage) || disk_buf.magic != DISK_MAGIC || disk_buf.version != DISK_VERSION ||
+        disk_buf.build_id != build_id || disk_buf.key != key) {
+        disk_stat.miss += 1;
+        return key;
+    }
+
+    for (uint32_t i = 0; i < DEC_PAGE_INST; i++)
+    {
+        uint32_t word;
+        memcpy(&word,mem + 4 * i,4);
+        if (disk_buf.inst[i].id != INST_NONE && disk_buf.inst[i].inst == word)
+            inst[i] = disk_buf.inst[i];
+    }
+    disk_stat.hit += 1;
+    return key;
+}
+
+void disk_cache_store(uint64_t key, const DecInst *inst)
+{
+    if (!disk_en || key == 0)
+        return;
+
+    char path[4096];
+    char tmp[sizeof(path) + 32];  // 加上".<pid>.tmp"
+    if (disk_path(path,sizeof(path),key) != 0)
+        return;
+    snprintf(tmp,sizeof(tmp),"%s.%d" DISK_TMP_SUFFIX,path,(int)getpid());
+
+    disk_buf.magic = DISK_MAGIC;
+    disk_buf.version = DISK_VERSION;
+    disk_buf.build_id = build_id;
+    disk_buf.key = key;
+    memcpy(disk_buf.inst,inst,sizeof(disk_buf.inst));
+
+    // 先写入临时文件再rename，其他进程只会看到完整的文件
+    int fd = open(tmp,O_WRONLY | O_CREAT | O_TRUNC,0644);
+    if (fd < 0)
+        return;
+    ssize_t n = write(fd,&disk_buf,sizeof(DiskPage));
+    close(fd);
+    if (n != (ssize_t)sizeof(DiskPage) || rename(tmp,path) != 0) {
+        unlink(tmp);
+        return;
+    }
+    disk_stat.store += 1;
+}
+
+static int file_cmp(const void *a, const void *b){
+    const struct timespec *ta = &(((const DiskFile*)a)->mtime);
+    const struct timespec *tb = &(((const DiskFile*)b)->mtime);
+    if (ta->tv_sec != tb->tv_sec)
+        return ta->tv_sec < tb->tv_sec ? -1 : 1;
+    if (ta->tv_nsec != tb->tv_nsec)
+        return ta->tv_nsec < tb->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+void disk_cache_evict()
+{
+    if (!disk_en)
+        return;
+    DIR *dp = opendir(disk_dir);
+    if (dp == NULL)
+        return;
+
+    DiskFile *file = NULL;
+    uint32_t file_num = 0, file_cap = 0;
+    uint64_t total = 0;
+    struct dirent *ent;
+    char path[4096];
+    struct stat st;
+    time_t now = time(NULL);
+    while ((ent = readdir(dp)) != NULL)
+    {
+        size_t len = strlen(ent->d_name);
+        // 写入途中退出的进程留下的临时文件不计入容量，过期后删除
+        if (len > strlen(DISK_TMP_SUFFIX) &&
+            strcmp(ent->d_name + len - strlen(DISK_TMP_SUFFIX),DISK_TMP_SUFFIX) == 0) {
+            snprintf(path,sizeof(path),"%s/%s",disk_dir,ent->d_name);
+            if (stat(path,&st) == 0 && now - st.st_mtime > DISK_TMP_AGE)
+                unlink(path);
+            continue;
+        }
+        if (len >= sizeof(file->name) || len < strlen(DISK_SUFFIX) ||
+            strcmp(ent->d_name + len - strlen(DISK_SUFFIX),DISK_SUFFIX) != 0)
+            continue;
+        snprintf(path,sizeof(path),"%s/%s",disk_dir,ent->d_name);
+        if (stat(path,&st) != 0)
+            continue;
+        if (file_num == file_cap) {
+            file_cap = file_cap ? file_cap * 2 : 256;
+            file = (DiskFile*)realloc(file,sizeof(DiskFile) * file_cap);
+        }
+        file[file_num].mtime = st.st_mtim;
+        file[file_num].size = (uint64_t)st.st_size;
+        strcpy(file[file_num].name,ent->d_name);
+        file_num += 1;
+        total += (uint64_t)st.st_size;
+    }
+    closedir(dp);
+
+    // 其他进程可能同时在删除，文件已经不存在时忽略
+    if (total > disk_cap) {
+        qsort(file,file_num,sizeof(DiskFile),file_cmp);
+        for (uint32_t i = 0; i < file_num && total > disk_cap; i++)
+        {
+            snprintf(path,sizeof(path),"%s/%s",disk_dir,file[i].name);
+            if (unlink(path) == 0)
+                disk_stat.evict += 1;
+            total -= file[i].size;
+        }
+    }
+    free(file);
+}
+
+DiskCacheStat* get_disk_cache_stat()
+{
+    return &disk_stat;
+}
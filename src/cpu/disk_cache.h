@@ -0,0 +1,72 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// 译码缓存的磁盘持久化
+// 以页内容的哈希和模拟器可执行文件的哈希（build ID）为键，将译码缓存中的页保存到目录中，
+// 再次运行相同的程序时，页第一次被访问就可以直接装入之前的译码结果
+// 装入时逐条比较原始指令与内存中的内容，哈希冲突或者内容不一致的表项不会被使用
+// 文件先写入临时文件再rename，多个进程可以同时读写同一个目录
+// 目录超过容量上限时按照最近使用时间（mtime）删除最旧的文件
+
+#ifndef __DISK_CACHE_H__
+    #define __DISK_CACHE_H__
+
+#include <stdint.h>
+#include "predecode.h"
+
+#define DISK_CACHE_CAP  (64 * 1024 * 1024) // 默认的容量上限
+
+typedef struct disk_cache_stat_t
+{
+    uint64_t hit;   // 从磁盘装入的页数
+    uint64_t miss;  // 磁盘中没有的页数
+    uint64_t store; // 写入磁盘的页数
+    uint64_t evict; // 因为容量上限删除的文件数
+} DiskCacheStat;
+
+// 使用dir作为缓存目录，目录不存在时创建
+// cap为目录的容量上限，单位为byte
+// 成功返回0，失败返回1，失败时不使用磁盘缓存
+int disk_cache_init(const char *dir, uint64_t cap);
+void disk_cache_free();
+
+// page_tag对应的页第一次装入译码缓存时调用，inst为该页的DEC_PAGE_INST个表项
+// 返回页内容的键，之后用于保存；不在DRAM中或者没有使能时返回0
+uint64_t disk_cache_load(uint64_t page_tag, DecInst *inst);
+
+// 计算page_tag对应的页当前内容的键，不在DRAM中或者没有使能时返回0
+uint64_t disk_cache_key(uint64_t page_tag);
+
+// 以key保存的文件是否已经存在
+int disk_cache_stored(uint64_t key);
+
+// 将一页的译码结果以key保存到磁盘
+void disk_cache_store(uint64_t key, const DecInst *inst);
+
+// 目录超过容量上限时删除最久没有使用的文件
+void disk_cache_evict();
+
+DiskCacheStat* get_disk_cache_stat();
+
+#endif //__DISK_CACHE_H__
@@ -0,0 +1,115 @@
+
+// 执行引擎共用的handler
+// 只能在执行引擎函数的内部被包含，使用的宏和变量见engine_ops.h
+// 每次包含都会展开一份完整的handler，因此不加头文件保护
+
+    // OP_32
+h_add:    add(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_sub:    sub(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_sll:    sll(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_slt:    slt(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_sltu:   sltu(d->rd,d->rs1,d->rs2);   ENG_NEXT();
+h_xor:    xor(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_srl:    srl(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_sra:    sra(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_or:     or(d->rd,d->rs1,d->rs2);     ENG_NEXT();
+h_and:    and(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+    // M extension
+h_mul:    mul(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_mulh:   mulh(d->rd,d->rs1,d->rs2);   ENG_NEXT();
+h_mulhsu: mulhsu(d->rd,d->rs1,d->rs2); ENG_NEXT();
+h_mulhu:  mulhu(d->rd,d->rs1,d->rs2);  ENG_NEXT();
+h_div:    div(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_divu:   divu(d->rd,d->rs1,d->rs2);   ENG_NEXT();
+h_rem:    rem(d->rd,d->rs1,d->rs2);    ENG_NEXT();
+h_remu:   remu(d->rd,d->rs1,d->rs2);   ENG_NEXT();
+    // OP_IMM
+h_addi:   addi(d->rd,d->rs1,d->imm);   ENG_NEXT();
+h_slti:   slti(d->rd,d->rs1,d->imm);   ENG_NEXT();
+h_sltiu:  sltiu(d->rd,d->rs1,d->imm);  ENG_NEXT();
+h_xori:   xori(d->rd,d->rs1,d->imm);   ENG_NEXT();
+h_ori:    ori(d->rd,d->rs1,d->imm);    ENG_NEXT();
+h_andi:   andi(d->rd,d->rs1,d->imm);   ENG_NEXT();
+h_slli:   slli(d->rd,d->rs1,(uint8_t)d->imm); ENG_NEXT();
+h_srli:   srli(d->rd,d->rs1,(uint8_t)d->imm); ENG_NEXT();
+h_srai:   srai(d->rd,d->rs1,(uint8_t)d->imm); ENG_NEXT();
+    // BRANCH
+h_beq:    br_cnt += 1; beq(d->rs1,d->rs2,d->imm);  ENG_BRANCH();
+h_bne:    br_cnt += 1; bne(d->rs1,d->rs2,d->imm);  ENG_BRANCH();
+h_blt:    br_cnt += 1; blt(d->rs1,d->rs2,d->imm);  ENG_BRANCH();
+h_bge:    br_cnt += 1; bgt(d->rs1,d->rs2,d->imm);  ENG_BRANCH();
+h_bltu:   br_cnt += 1; bltu(d->rs1,d->rs2,d->imm); ENG_BRANCH();
+h_bgeu:   br_cnt += 1; bgeu(d->rs1,d->rs2,d->imm); ENG_BRANCH();
+    // JUMP
+h_jal:    jmp_cnt += 1; jal(d->rd,d->imm);         ENG_JUMP();
+h_jalr:   jmp_cnt += 1; jalr(d->rd,d->rs1,d->imm); ENG_JUMP();
+    // LOAD，访问出错时直接进入异常处理
+h_lb:     if (lb(d->rd,d->rs1,d->imm)) goto eng_trap;    ENG_NEXT();
+h_lh:     if (lh(d->rd,d->rs1,d->imm)) goto eng_trap;    ENG_NEXT();
+h_lw:     if (lw(d->rd,d->rs1,d->imm)) goto eng_trap;    ENG_NEXT();
+h_lbu:    if (lbu(d->rd,d->rs1,d->imm)) goto eng_trap;   ENG_NEXT();
+h_lhu:    if (lhu(d->rd,d->rs1,d->imm)) goto eng_trap;   ENG_NEXT();
+    // STORE
+h_sb:     if (sb(d->rs1,d->rs2,d->imm)) goto eng_trap;    ENG_STORE();
+h_sh:     if (sh(d->rs1,d->rs2,d->imm)) goto eng_trap;    ENG_STORE();
+h_sw:     if (sw(d->rs1,d->rs2,d->imm)) goto eng_trap;    ENG_STORE();
+    // load imme
+h_lui:    lui(d->rd,d->imm);           ENG_NEXT();
+h_auipc:  auipc(d->rd,d->imm);         ENG_NEXT();
+    // 融合指令对
+    // 两条指令仍然分别执行，第二条指令的异常和instret与单独执行时一致
+h_f_lui_addi:   fuse_cnt += 1; lui(d->rd,d->imm);   ENG_FUSED(); addi(d->rd,d->rs1,d->imm); ENG_NEXT();
+h_f_auipc_lw:   fuse_cnt += 1; auipc(d->rd,d->imm); ENG_FUSED(); if (lw(d->rd,d->rs1,d->imm)) goto eng_trap; ENG_NEXT();
+h_f_slli_srli:  fuse_cnt += 1; slli(d->rd,d->rs1,(uint8_t)d->imm); ENG_FUSED(); srli(d->rd,d->rs1,(uint8_t)d->imm); ENG_NEXT();
+h_f_auipc_jalr: fuse_cnt += 1; auipc(d->rd,d->imm); ENG_FUSED(); jmp_cnt += 1; jalr(d->rd,d->rs1,d->imm); ENG_JUMP();
+h_f_slt_br:     fuse_cnt += 1; slt(d->rd,d->rs1,d->rs2);   ENG_FUSED(); goto h_f_br;
+h_f_sltu_br:    fuse_cnt += 1; sltu(d->rd,d->rs1,d->rs2);  ENG_FUSED(); goto h_f_br;
+h_f_slti_br:    fuse_cnt += 1; slti(d->rd,d->rs1,d->imm);  ENG_FUSED(); goto h_f_br;
+h_f_sltiu_br:   fuse_cnt += 1; sltiu(d->rd,d->rs1,d->imm); ENG_FUSED(); goto h_f_br;
+h_f_br:
+    br_cnt += 1;
+    if (d->id == INST_BEQ)
+        beq(d->rs1,d->rs2,d->imm);
+    else
+        bne(d->rs1,d->rs2,d->imm);
+    ENG_BRANCH();
+    // MISC_MEM
+h_nop:    uop();                       ENG_NEXT();
+h_fence_i:fence_i();                   ENG_STORE();
+    // SYSTEM
+h_ecall:  ENG_SYS_BEGIN(); ecall();                       ENG_SYS_END();
+h_ebreak: ENG_SYS_BEGIN(); ebreak();                      ENG_SYS_END();
+h_csrrw:  ENG_SYS_BEGIN(); csrrw(d->rd,d->rs1,d->imm);    ENG_SYS_END();
+h_csrrs:  ENG_SYS_BEGIN(); csrrs(d->rd,d->rs1,d->imm);    ENG_SYS_END();
+h_csrrc:  ENG_SYS_BEGIN(); csrrc(d->rd,d->rs1,d->imm);    ENG_SYS_END();
+h_csrrwi: ENG_SYS_BEGIN(); csrrwi(d->rd,d->rs1,d->imm);   ENG_SYS_END();
+h_csrrsi: ENG_SYS_BEGIN(); csrrsi(d->rd,d->rs1,d->imm);   ENG_SYS_END();
+h_csrrci: ENG_SYS_BEGIN(); csrrci(d->rd,d->rs1,d->imm);   ENG_SYS_END();
+h_mret:
+    ENG_SYS_BEGIN();
+    mret();
+    if (e_st->exception)
+        goto eng_trap;
+    // mret_proc() 已经将mepc写入了e_st->next_pc
+    next_pc = e_st->next_pc;
+    trap_clear(e_st);
+    retired += 1;
+    pc = next_pc;
+    goto eng_exit;
+h_illegal:
+    undef();
+    goto eng_trap;
+
+eng_trap:
+    // 与instruction_execute()中的异常处理保持一致
+    e_st->curr_pc = pc;
+    exception_proc(e_st,curr_mode,d->inst);
+    next_pc = e_st->next_pc;
+    trap_clear(e_st);
+    retired += 1;
+    pc = next_pc;
+
+eng_exit:
+    e_st->next_pc = pc;
+    instreth_inc(retired - counted);
+    return retired;
@@ -0,0 +1,110 @@
+
+// 执行引擎共用的定义
+// threaded code 和 block 等执行引擎使用相同的handler实现，只有指令之间的衔接方式不同
+// 每个引擎需要在函数内部定义以下宏，然后包含engine_body.h：
+//   ENG_NEXT()   : 退休当前指令，执行顺序的下一条指令
+//   ENG_STORE()  : store指令执行后的处理，写操作可能修改了已经缓存的代码
+//   ENG_BRANCH() : 分支指令执行后的处理，需要检查异常
+//   ENG_JUMP()   : jal和jalr执行后的处理，需要检查异常
+//   ENG_FUSED()  : 融合指令对的第一条执行完成，退休后直接执行第二条，不经过分发
+// 以及以下变量：
+//   e_st, curr_mode, d(当前指令的DecInst*), retired(已退休指令数), counted(已计入instret的指令数)
+// 本文件只能被back_end.c包含的执行引擎使用
+
+#ifndef __ENGINE_OPS_H__
+    #define __ENGINE_OPS_H__
+
+#include "predecode.h"
+
+// InstID和FuseID 到handler的映射，用于初始化函数内的label地址表
+#define ENG_HANDLER_TABLE                   \
+        [INST_NONE]     = &&h_illegal,      \
+        [INST_ILLEGAL]  = &&h_illegal,      \
+        [INST_NOP]      = &&h_nop,          \
+        [INST_ADD]      = &&h_add,          \
+        [INST_SUB]      = &&h_sub,          \
+        [INST_SLL]      = &&h_sll,          \
+        [INST_SLT]      = &&h_slt,          \
+        [INST_SLTU]     = &&h_sltu,         \
+        [INST_XOR]      = &&h_xor,          \
+        [INST_SRL]      = &&h_srl,          \
+        [INST_SRA]      = &&h_sra,          \
+        [INST_OR]       = &&h_or,           \
+        [INST_AND]      = &&h_and,          \
+        [INST_MUL]      = &&h_mul,          \
+        [INST_MULH]     = &&h_mulh,         \
+        [INST_MULHSU]   = &&h_mulhsu,       \
+        [INST_MULHU]    = &&h_mulhu,        \
+        [INST_DIV]      = &&h_div,          \
+        [INST_DIVU]     = &&h_divu,         \
+        [INST_REM]      = &&h_rem,          \
+        [INST_REMU]     = &&h_remu,         \
+        [INST_ADDI]     = &&h_addi,         \
+        [INST_SLTI]     = &&h_slti,         \
+        [INST_SLTIU]    = &&h_sltiu,        \
+        [INST_XORI]     = &&h_xori,         \
+        [INST_ORI]      = &&h_ori,          \
+        [INST_ANDI]     = &&h_andi,         \
+        [INST_SLLI]     = &&h_slli,         \
+        [INST_SRLI]     = &&h_srli,         \
+        [INST_SRAI]     = &&h_srai,         \
+        [INST_BEQ]      = &&h_beq,          \
+        [INST_BNE]      = &&h_bne,          \
+        [INST_BLT]      = &&h_blt,          \
+        [INST_BGE]      = &&h_bge,          \
+        [INST_BLTU]     = &&h_bltu,         \
+        [INST_BGEU]     = &&h_bgeu,         \
+        [INST_JAL]      = &&h_jal,          \
+        [INST_JALR]     = &&h_jalr,         \
+        [INST_LB]       = &&h_lb,           \
+        [INST_LH]       = &&h_lh,           \
+        [INST_LW]       = &&h_lw,           \
+        [INST_LBU]      = &&h_lbu,          \
+        [INST_LHU]      = &&h_lhu,          \
+        [INST_SB]       = &&h_sb,           \
+        [INST_SH]       = &&h_sh,           \
+        [INST_SW]       = &&h_sw,           \
+        [INST_LUI]      = &&h_lui,          \
+        [INST_AUIPC]    = &&h_auipc,        \
+        [INST_ECALL]    = &&h_ecall,        \
+        [INST_EBREAK]   = &&h_ebreak,       \
+        [INST_MRET]     = &&h_mret,         \
+        [INST_WFI]      = &&h_nop,          \
+        [INST_CSRRW]    = &&h_csrrw,        \
+        [INST_CSRRS]    = &&h_csrrs,        \
+        [INST_CSRRC]    = &&h_csrrc,        \
+        [INST_CSRRWI]   = &&h_csrrwi,       \
+        [INST_CSRRSI]   = &&h_csrrsi,       \
+        [INST_CSRRCI]   = &&h_csrrci,       \
+        [INST_FENCE]    = &&h_nop,          \
+        [INST_FENCE_TSO]= &&h_nop,          \
+        [INST_PAUSE]    = &&h_nop,          \
+        [INST_FENCE_I]  = &&h_fence_i,      \
+        [FUSE_LUI_ADDI]  = &&h_f_lui_addi,  \
+        [FUSE_AUIPC_JALR]= &&h_f_auipc_jalr,\
+        [FUSE_AUIPC_LW]  = &&h_f_auipc_lw,  \
+        [FUSE_SLLI_SRLI] = &&h_f_slli_srli, \
+        [FUSE_SLT_BR]    = &&h_f_slt_br,    \
+        [FUSE_SLTU_BR]   = &&h_f_sltu_br,   \
+        [FUSE_SLTI_BR]   = &&h_f_slti_br,   \
+        [FUSE_SLTIU_BR]  = &&h_f_sltiu_br
+
+// SYSTEM指令可能会读取instret，或者修改中断使能和特权模式
+// 执行前同步instret，执行后退出引擎，由cpu_run()重新检查中断和模式
+#define ENG_SYS_BEGIN()                                                 \
+    do {                                                                \
+        instreth_inc(retired - counted);                                \
+        counted = retired;                                              \
+        e_st->curr_pc = pc;                                             \
+    } while (0)
+
+#define ENG_SYS_END()                                                   \
+    do {                                                                \
+        if (e_st->exception)                                            \
+            goto eng_trap;                                              \
+        retired += 1;                                                   \
+        pc += 4;                                                        \
+        goto eng_exit;                                                  \
+    } while (0)
+
+#endif //__ENGINE_OPS_H__
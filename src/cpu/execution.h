@@ -3,10 +3,13 @@
 
 #include <stdint.h>
 #include <assert.h>
+#include <string.h>
 #include "../dev/memory.h"
 #include "sys_reg.h"
 #include "../include/comm.h"
 #include "cpu_glb.h"
+#include "dec_cache.h"
+#include "block_cache.h"
 
 static inline MXLEN_ST signed_ext(MXLEN_T source, uint8_t sign_loc){
     MXLEN_T top_bit = source >> sign_loc;
@@ -23,6 +26,15 @@ static inline DMXLEN_ST mulsigned_ext(MXLEN_T source){
     return result;
 }
 
+// 产生异常，只记录异常号和附加信息，由exception_proc()完成trap
+// 放在正常执行路径之外，没有异常时不会访问这些状态
+static __attribute__((cold, noinline)) void raise_exc(uint8_t cause, MXLEN_T tval){
+    ExeStatus *e_st = get_exe_st_ptr();
+    e_st->exception = 1;
+    e_st->ecause = cause;
+    e_st->tval = tval;
+}
+
 // 处理不对齐的target PC，必须在指令跳转之前完成处理
 // 且错误的指令不能执行
 // 详情见：The RISC-V Instruction Set Manual: Volume II
@@ -36,9 +48,7 @@ static inline uint8_t misaligned_target_check(MXLEN_T next_pc){
 
     if ((next_pc & align_msk) > 0) {
         // 发现misaligned address
-        ExeStatus *e_st = get_exe_st_ptr();
-        e_st->exception = 1;
-        e_st->ecause.instruction_address_misaligned = 1;
+        raise_exc(EXC_INST_MISALIGNED,next_pc);
         return 1;
     }
     else
@@ -362,83 +372,115 @@ static inline void jalr(uint8_t rd, uint8_t rs1, int32_t imm){
 }
 // load
 
+// 经过memory.h中按宽度的访问函数，store写到代码时由back_end.c中的store_inval()使译码缓存和基本块失效
+
 // 加载字节，符号扩展
-static inline void lb(uint8_t rd, uint8_t rs1, int32_t imm){
+static inline uint8_t lb(uint8_t rd, uint8_t rs1, int32_t imm){
     MXLEN_T r1 = (MXLEN_T)(x[rs1]);
     uint8_t rd_data;
     MXLEN_T addr = addr_calc(r1,imm);
-    int read_num = read_data(addr,1,CPU_BE,&rd_data);
-    assert(read_num == 0); // load指令必须有数据返回
+    int read_num = mem_read_u8(addr,CPU_BE,&rd_data);
+    if (read_num != 0) {
+        // 访问出错时不写rd
+        raise_exc(EXC_LOAD_ACCESS_FAULT,addr);
+        return 1;
+    }
     if (rd != 0)
         x[rd] = signed_ext(rd_data,7);
-
+    return 0;
 }
 // 加载半字，符号扩展
-static inline void lh(uint8_t rd, uint8_t rs1, int32_t imm){
+static inline uint8_t lh(uint8_t rd, uint8_t rs1, int32_t imm){
     MXLEN_T r1 = (MXLEN_T)(x[rs1]);
     uint16_t rd_data;
     MXLEN_T addr = addr_calc(r1,imm);
-    int read_num = read_data(addr,2,CPU_BE,(uint8_t*)(&rd_data));
-    assert(read_num == 0); // load指令必须有数据返回
+    int read_num = mem_read_u16(addr,CPU_BE,&rd_data);
+    if (read_num != 0) {
+        raise_exc(EXC_LOAD_ACCESS_FAULT,addr);
+        return 1;
+    }
     if (rd != 0) {
         x[rd] = signed_ext(rd_data,15);
     }
+    return 0;
 }
 // 加载字
-static inline void lw(uint8_t rd, uint8_t rs1, int32_t imm){
+static inline uint8_t lw(uint8_t rd, uint8_t rs1, int32_t imm){
     MXLEN_T r1 = (MXLEN_T)(x[rs1]);
-    int32_t rd_data;
+    uint32_t rd_data;
     MXLEN_T addr = addr_calc(r1,imm);
-    int read_num = read_data(addr,4,CPU_BE,(uint8_t*)(&rd_data));
-    assert(read_num == 0); // load指令必须有数据返回
+    int read_num = mem_read_u32(addr,CPU_BE,&rd_data);
+    if (read_num != 0) {
+        raise_exc(EXC_LOAD_ACCESS_FAULT,addr);
+        return 1;
+    }
     if (rd != 0) {
-        x[rd] = rd_data;
+        x[rd] = (MXLEN_T)(int32_t)rd_data;
     }
+    return 0;
 }
 // 加载字节，无符号扩展
-static inline void lbu(uint8_t rd, uint8_t rs1, int32_t imm){
+static inline uint8_t lbu(uint8_t rd, uint8_t rs1, int32_t imm){
     MXLEN_T r1 = (MXLEN_T)(x[rs1]);
     uint8_t rd_data;
     MXLEN_T addr = addr_calc(r1,imm);
-    int read_num = read_data(addr,1,CPU_BE,&rd_data);
-    assert(read_num == 0); // load指令必须有数据返回
+    int read_num = mem_read_u8(addr,CPU_BE,&rd_data);
+    if (read_num != 0) {
+        raise_exc(EXC_LOAD_ACCESS_FAULT,addr);
+        return 1;
+    }
     if (rd != 0)
         x[rd] = (MXLEN_T)(rd_data);
+    return 0;
 }
 // 加载半字，无符号扩展
-static inline void lhu(uint8_t rd, uint8_t rs1, int32_t imm){
+static inline uint8_t lhu(uint8_t rd, uint8_t rs1, int32_t imm){
     MXLEN_T r1 = (MXLEN_T)(x[rs1]);
     uint16_t rd_data;
     MXLEN_T addr = addr_calc(r1,imm);
-    int read_num = read_data(addr,2,CPU_BE,(uint8_t*)(&rd_data));
-    assert(read_num == 0); // load指令必须有数据返回
+    int read_num = mem_read_u16(addr,CPU_BE,&rd_data);
+    if (read_num != 0) {
+        raise_exc(EXC_LOAD_ACCESS_FAULT,addr);
+        return 1;
+    }
     if (rd != 0) {
         x[rd] = (MXLEN_T)(rd_data);
     }
+    return 0;
 }
 //store
-static inline void sb(uint8_t rs1, uint8_t rs2, int32_t imm){
+static inline uint8_t sb(uint8_t rs1, uint8_t rs2, int32_t imm){
     MXLEN_T r1 = (MXLEN_T)(x[rs1]);
     MXLEN_T r2 = (MXLEN_T)(x[rs2]);
-    uint8_t wr_data = (uint8_t)r2;
     MXLEN_T addr = addr_calc(r1,imm);
-    int write_num = write_data(addr,1,CPU_BE,&wr_data);
-    assert(write_num == 0); // write指令必须有数据返回
+    int write_num = mem_write_u8(addr,CPU_BE,(uint8_t)r2);
+    if (write_num != 0) {
+        raise_exc(EXC_STORE_ACCESS_FAULT,addr);
+        return 1;
+    }
+    return 0;
 }
-static inline void sh(uint8_t rs1, uint8_t rs2, int32_t imm){
+static inline uint8_t sh(uint8_t rs1, uint8_t rs2, int32_t imm){
     MXLEN_T r1 = (MXLEN_T)(x[rs1]);
     MXLEN_T r2 = (MXLEN_T)(x[rs2]);
-    uint8_t wr_data[2] = {(uint8_t)r2,(uint8_t)(r2 >> 8)};
     MXLEN_T addr = addr_calc(r1,imm);
-    int write_num = write_data(addr,2,CPU_BE,wr_data);
-    assert(write_num == 0); // write指令必须有数据返回
+    int write_num = mem_write_u16(addr,CPU_BE,(uint16_t)r2);
+    if (write_num != 0) {
+        raise_exc(EXC_STORE_ACCESS_FAULT,addr);
+        return 1;
+    }
+    return 0;
 }
-static inline void sw(uint8_t rs1, uint8_t rs2, int32_t imm){
+static inline uint8_t sw(uint8_t rs1, uint8_t rs2, int32_t imm){
     MXLEN_T r1 = (MXLEN_T)(x[rs1]);
     MXLEN_T r2 = (MXLEN_T)(x[rs2]);
     MXLEN_T addr = addr_calc(r1,imm);
-    int write_num = write_data(addr,4,CPU_BE,(uint8_t*)(&r2));
-    assert(write_num == 0); // write指令必须有数据返回
+    int write_num = mem_write_u32(addr,CPU_BE,(uint32_t)r2);
+    if (write_num != 0) {
+        raise_exc(EXC_STORE_ACCESS_FAULT,addr);
+        return 1;
+    }
+    return 0;
 }
 // load imme
 static inline void lui(uint8_t rd, int32_t imm){
@@ -466,29 +508,25 @@ static inline void ecall(){
         return;
     }
 
-    e_st->exception = 1;
     if (curr_mode == U)
-        e_st->ecause.ecall_from_u = 1;
+        raise_exc(EXC_ECALL_U,0);
     #ifdef S_MODE
-    else if (curr_mode == M)
-        e_st->ecause.ecall_from_s = 1;
+    else if (curr_mode == S)
+        raise_exc(EXC_ECALL_S,0);
     #endif
     else if (curr_mode == M)
-        e_st->ecause.ecall_from_m = 1;
+        raise_exc(EXC_ECALL_M,0);
 
 }
 static inline void ebreak(){
-    ExeStatus *e_st = get_exe_st_ptr();
-    e_st->exception = 1;
-    e_st->ecause.ecall_breakpoint = 1;
+    raise_exc(EXC_BREAKPOINT,0);
 }
 static inline void mret(){
     ExeStatus *e_st = get_exe_st_ptr();
     CPUMode curr_mode = get_cpu_mode();
     if (curr_mode != M){
         //如果在非M模式下执行，直接报异常
-        e_st->exception = 1;
-        e_st->ecause.illegal_instruction = 1;
+        raise_exc(EXC_ILLEGAL_INST,0);
         return;
     }
     e_st->mret = 1;
@@ -499,7 +537,6 @@ static inline void wfi(){
 }
 
 static inline int csr_check(CSRFeild csr_id,int write){
-    ExeStatus *e_st = get_exe_st_ptr();
     CPUMode curr_mode = get_cpu_mode();
     int err_flag = 0;
     // 检查是否访问了高权限寄存器
@@ -521,10 +558,7 @@ static inline int csr_check(CSRFeild csr_id,int write){
     }
 
     if (err_flag == 1)
-    {
-        e_st->exception =1;
-        e_st->ecause.illegal_instruction =1;
-    }
+        raise_exc(EXC_ILLEGAL_INST,0);
 
     return err_flag;
 }
@@ -665,13 +699,14 @@ static inline void pause(){
 static inline void fence(uint8_t rd, uint8_t rs1, uint8_t succ,uint8_t pred,uint8_t fm){
     uop();
 }
+// store已经使被改写的基本块失效，这里检查以其他方式改写的代码
 static inline void fence_i(){
-    uop();
+    // 先使译码缓存失效，基本块重建时才会重新译码
+    dec_cache_fence();
+    blk_cache_fence();
 }
 // Undefined
 static inline void undef(){
-    ExeStatus *e_st = get_exe_st_ptr();
-    e_st->exception =1;
-    e_st->ecause.illegal_instruction =1;
+    raise_exc(EXC_ILLEGAL_INST,0);
 }
 #endif //__EXECUTION_H__
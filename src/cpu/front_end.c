@@ -23,20 +23,78 @@ SOFTWARE.
 */
 
 
+#include <stddef.h>
+#include <string.h>
 #include "front_end.h"
 #include "cpu_config.h"
+#include "predecode.h"
+#include "dec_cache.h"
 #include "../dev/memory.h"
+#include "../dev/mem_pool.h"
+#include "../dev/dev_config.h"
+#include "../include/comm.h"
 
-void instruction_fetch(FetchParam* fetch_param, uint32_t* inst_buf)
+static DecInst dec_buf; // 译码缓存缺失时的译码结果
+
+// 取指页缓存，记录最近一次取指的DRAM页在内存池中的host地址
+// 内存池中的页分配之后地址不变，代码被改写时也是直接读到新的内容，不需要失效
+// 与软件TLB相同，pc的低两位并入tag，对齐的取指是一次host的load
+// 设备地址、不对齐和跨页的取指经过mem_read_u32()
+static uint64_t fetch_tag = TLB_INVALID;
+static uint8_t *fetch_page;
+
+// FETCH_NUM为1，每次取一条指令
+static int fetch_inst(uint64_t pc, uint32_t *inst){
+    if (tlb_key(pc,4) == fetch_tag) {
+        memcpy(inst,fetch_page + MOD(pc,ENTRY_SIZE),4);
+        return 0;
+    }
+    int res = mem_read_u32(pc,CPU_FE,inst);
+    if (res == 0 && pc >= DRAM_BASE && pc <= DRAM_END) {
+        fetch_tag = ROUND(pc,ENTRY_SIZE);
+        fetch_page = mem_pool_lkup(fetch_tag);
+    }
+    return res;
+}
+
+DecInst* instruction_fetch(FetchParam* fetch_param, uint32_t* inst_buf)
 {
     FetchStatus *f_st_ptr = get_fet_st_ptr();
-    int inst_fetch = read_data(fetch_param->pc,FETCH_NUM*4,CPU_FE,(uint8_t*)inst_buf);
+    DecInst *dec = dec_cache_lkup(fetch_param->pc);
+    if (dec != NULL)
+    {
+        f_st_ptr->inst_num = FETCH_NUM;
+        return dec;
+    }
+
+    int inst_fetch = fetch_inst(fetch_param->pc,inst_buf);
     if (inst_fetch == 0)
     {
         f_st_ptr->err_id = get_ifu_fault();
         f_st_ptr->inst_num = 0;
+        // 只缓存成功取到的指令
+        dec = dec_cache_fill(fetch_param->pc,*inst_buf);
     }
     else {
         f_st_ptr->inst_num = FETCH_NUM;
     }
+
+    if (dec == NULL)
+    {
+        predecode(*inst_buf,&dec_buf);
+        dec = &dec_buf;
+    }
+    return dec;
+}
+
+DecInst* fetch_dec_inst(uint64_t pc)
+{
+    uint32_t inst;
+    DecInst *dec = dec_cache_lkup(pc);
+    if (dec != NULL)
+        return dec;
+
+    if (fetch_inst(pc,&inst) != 0)
+        return NULL;
+    return dec_cache_fill(pc,inst);
 }
@@ -29,6 +29,7 @@ SOFTWARE.
 #include <stdint.h>
 #include "cpu_glb.h"
 #include "cpu_config.h"
+#include "predecode.h"
 
 typedef struct inst_fetch_param
 {
@@ -42,10 +43,15 @@ typedef struct inst_fetch_param
 // 输入：
 //  fetch_param: 必要的参数
 //  inst_buf:    指向取指结果
-// 输出 （unsigned int）：成功取指的数量
-//  0：取指失败
-//  other: 取指成功
-void instruction_fetch(FetchParam* fetch_param, uint32_t* inst_buf);
+// 输出：指向译码结果
+//  译码缓存命中时直接返回缓存中的表项，跳过取指和译码
+//  取指的结果通过FetchStatus给出
+DecInst* instruction_fetch(FetchParam* fetch_param, uint32_t* inst_buf);
+
+// 给执行引擎使用的取指接口
+// 返回译码缓存中的表项，缺失时完成取指和译码并填入缓存
+// 取指失败或无法缓存时返回NULL，由调用者退回到instruction_fetch
+DecInst* fetch_dec_inst(uint64_t pc);
 
 
 
@@ -0,0 +1,148 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "guest_mem.h"
+#include "dec_cache.h"
+#include "../dev/mem_pool.h"
+#include "../dev/dev_config.h"
+#include "../include/comm.h"
+
+static inline uint8_t *host_ptr(uint64_t addr){
+    return mem_pool_lkup(ROUND(addr,ENTRY_SIZE)) + MOD(addr,ENTRY_SIZE);
+}
+
+// 从addr开始，到页结尾为止最多还有多少字节
+static inline uint64_t page_left(uint64_t addr, uint64_t len){
+    uint64_t left = ENTRY_SIZE - MOD(addr,ENTRY_SIZE);
+    return (len < left) ? len : left;
+}
+
+int gmem_is_dram(uint64_t addr, uint64_t len)
+{
+    return len > 0 && addr >= DRAM_BASE && addr + len - 1 <= DRAM_END;
+}
+
+int gmem_writable(uint64_t addr, uint64_t len)
+{
+    for (uint64_t a = ROUND(addr,ENTRY_SIZE); a < addr + len; a += ENTRY_SIZE)
+    {
+        if (mem_pool_is_code(a) || dec_cache_has_page(a))
+            return 0;
+    }
+    return 1;
+}
+
+void gmem_move(uint64_t dst, uint64_t src, uint64_t len)
+{
+    // 页之间在host中不连续，目的在源之后并且重叠时从后向前复制
+    if (dst > src && dst < src + len) {
+        while (len > 0)
+        {
+            uint64_t chunk = MOD(src + len,ENTRY_SIZE);
+            uint64_t d_chunk = MOD(dst + len,ENTRY_SIZE);
+            if (chunk == 0) chunk = ENTRY_SIZE;
+            if (d_chunk == 0) d_chunk = ENTRY_SIZE;
+            if (chunk > d_chunk) chunk = d_chunk;
+            if (chunk > len) chunk = len;
+            len -= chunk;
+            memmove(host_ptr(dst + len),host_ptr(src + len),chunk);
+        }
+        return;
+    }
+    while (len > 0)
+    {
+        uint64_t chunk = page_left(dst,page_left(src,len));
+        memmove(host_ptr(dst),host_ptr(src),chunk);
+        src += chunk;
+        dst += chunk;
+        len -= chunk;
+    }
+}
+
+void gmem_fill(uint64_t dst, uint32_t val, uint8_t size, uint64_t len)
+{
+    uint8_t byte = (uint8_t)val;
+    uint8_t same = (size == 1) || (size == 2 && (uint16_t)val == byte * 0x0101u) || (val == byte * 0x01010101u);
+    uint64_t done = 0;
+    while (done < len)
+    {
+        uint64_t chunk = page_left(dst + done,len - done);
+        uint8_t *p = host_ptr(dst + done);
+        if (same)
+            memset(p,byte,chunk);
+        else {
+            // 元素可能跨页，按在元素中的位置逐字节写入
+            for (uint64_t i = 0; i < chunk; i++)
+                p[i] = (uint8_t)(val >> (8 * ((done + i) % size)));
+        }
+        done += chunk;
+    }
+}
+
+uint64_t gmem_find(uint64_t addr, uint8_t byte, uint64_t limit)
+{
+    uint64_t n = 0;
+    while (n < limit)
+    {
+        uint64_t chunk = page_left(addr + n,limit - n);
+        uint8_t *p = host_ptr(addr + n);
+        uint8_t *z = memchr(p,byte,chunk);
+        if (z != NULL)
+            return n + (z - p);
+        n += chunk;
+    }
+    return limit;
+}
+
+int gmem_cmp(uint64_t a, uint64_t b, uint64_t len)
+{
+    while (len > 0)
+    {
+        uint64_t chunk = page_left(a,page_left(b,len));
+        uint8_t *pa = host_ptr(a);
+        uint8_t *pb = host_ptr(b);
+        if (memcmp(pa,pb,chunk) != 0) {
+            for (uint64_t i = 0; i < chunk; i++)
+            {
+                if (pa[i] != pb[i])
+                    return (int)pa[i] - (int)pb[i];
+            }
+        }
+        a += chunk;
+        b += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+uint32_t gmem_read(uint64_t addr, uint8_t size)
+{
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < size; i++)
+        v |= (uint32_t)(*host_ptr(addr + i)) << (8 * i);
+    return v;
+}
@@ -0,0 +1,56 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// 批量访问guest内存
+// 供host一次完成多个guest访存的功能使用（循环模式识别和HLE），地址范围可以跨页，内部按页分段
+// 只处理DRAM，调用者需要先检查访问范围，范围中有设备地址时由guest代码逐条执行
+// 写入之前需要检查gmem_writable()，不满足时同样由guest代码执行，这样不需要使译码缓存和基本块失效
+
+#ifndef __GUEST_MEM_H__
+    #define __GUEST_MEM_H__
+
+#include <stdint.h>
+
+// [addr, addr + len)都在DRAM中，len为0时返回0
+int gmem_is_dram(uint64_t addr, uint64_t len);
+
+// 写入[addr, addr + len)不会改写已经译码或者翻译的代码
+int gmem_writable(uint64_t addr, uint64_t len);
+
+// 复制len字节，与memmove相同，源和目的可以重叠
+void gmem_move(uint64_t dst, uint64_t src, uint64_t len);
+
+// 以size字节为一个元素，按小端重复写入val，共len字节，size为1，2或4
+void gmem_fill(uint64_t dst, uint32_t val, uint8_t size, uint64_t len);
+
+// 在[addr, addr + limit)中查找byte，返回第一次出现的偏移，没有找到时返回limit
+uint64_t gmem_find(uint64_t addr, uint8_t byte, uint64_t limit);
+
+// 比较len字节，返回第一个不同的字节之差（按无符号数），相同时返回0
+int gmem_cmp(uint64_t a, uint64_t b, uint64_t len);
+
+// 按小端读取size字节，size不超过4
+uint32_t gmem_read(uint64_t addr, uint8_t size);
+
+#endif //__GUEST_MEM_H__
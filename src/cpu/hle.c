@@ -0,0 +1,231 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hle.h"
+#include "guest_mem.h"
+#include "../dev/dev_config.h"
+
+// ABI中参数和返回值的寄存器
+#define A0 10
+#define A1 11
+#define A2 12
+#define A3 13
+
+// 软件浮点库的结果都是规范的quiet NaN
+#define F64_NAN 0x7ff8000000000000ULL
+#define F32_NAN 0x7fc00000U
+
+typedef int (*HleFunc)(MXLEN_T *x);
+
+typedef struct hle_entry_t
+{
+    const char *name;
+    HleFunc     func;
+} HleEntry;
+
+uint64_t hle_addr[HLE_HASH_SIZE];
+uint8_t  hle_id[HLE_HASH_SIZE];
+uint32_t hle_num;
+
+static HleStat hle_stat;
+// 按编号记录注册的函数，编号从1开始
+static HleFunc hook_func[HLE_MAX_HOOK + 1];
+
+// ----------------------------------------------
+// 字符串和内存
+// ----------------------------------------------
+static int hle_memcpy(MXLEN_T *x){
+    uint64_t dst = x[A0];
+    uint64_t src = x[A1];
+    uint64_t len = x[A2];
+    if (len == 0)
+        return 0;
+    if (!gmem_is_dram(src,len) || !gmem_is_dram(dst,len) || !gmem_writable(dst,len))
+        return 1;
+    // 重叠时的结果取决于guest的实现
+    if (dst < src + len && src < dst + len)
+        return 1;
+    gmem_move(dst,src,len);
+    return 0;
+}
+
+static int hle_memset(MXLEN_T *x){
+    uint64_t dst = x[A0];
+    uint64_t len = x[A2];
+    if (len == 0)
+        return 0;
+    if (!gmem_is_dram(dst,len) || !gmem_writable(dst,len))
+        return 1;
+    gmem_fill(dst,(uint8_t)x[A1],1,len);
+    return 0;
+}
+
+static int hle_strlen(MXLEN_T *x){
+    uint64_t src = x[A0];
+    if (!gmem_is_dram(src,1))
+        return 1;
+    uint64_t limit = (uint64_t)DRAM_END + 1 - src;
+    uint64_t n = gmem_find(src,0,limit);
+    // 超出DRAM的部分由guest代码执行，产生访问错误
+    if (n == limit)
+        return 1;
+    x[A0] = (MXLEN_T)n;
+    return 0;
+}
+
+static int hle_memcmp(MXLEN_T *x){
+    uint64_t a = x[A0];
+    uint64_t b = x[A1];
+    uint64_t len = x[A2];
+    if (len != 0 && (!gmem_is_dram(a,len) || !gmem_is_dram(b,len)))
+        return 1;
+    x[A0] = (MXLEN_T)(int32_t)gmem_cmp(a,b,len);
+    return 0;
+}
+
+// ----------------------------------------------
+// 软件浮点
+// ----------------------------------------------
+// double在寄存器对中传递，低32位在编号小的寄存器
+static double get_f64(MXLEN_T *x, uint8_t r){
+    uint64_t v = ((uint64_t)(uint32_t)x[r + 1] << 32) | (uint32_t)x[r];
+    double d;
+    memcpy(&d,&v,sizeof(d));
+    return d;
+}
+
+static void set_f64(MXLEN_T *x, double d){
+    uint64_t v;
+    memcpy(&v,&d,sizeof(v));
+    if (d != d)
+        v = F64_NAN;
+    x[A0] = (MXLEN_T)(uint32_t)v;
+    x[A1] = (MXLEN_T)(uint32_t)(v >> 32);
+}
+
+static float get_f32(MXLEN_T *x, uint8_t r){
+    uint32_t v = (uint32_t)x[r];
+    float f;
+    memcpy(&f,&v,sizeof(f));
+    return f;
+}
+
+static void set_f32(MXLEN_T *x, float f){
+    uint32_t v;
+    memcpy(&v,&f,sizeof(v));
+    if (f != f)
+        v = F32_NAN;
+    x[A0] = (MXLEN_T)v;
+}
+
+// host的浮点运算与软件浮点库一样，使用IEEE 754的双精度和单精度，舍入模式为round to nearest even
+static int hle_adddf3(MXLEN_T *x){ set_f64(x,get_f64(x,A0) + get_f64(x,A2)); return 0; }
+static int hle_subdf3(MXLEN_T *x){ set_f64(x,get_f64(x,A0) - get_f64(x,A2)); return 0; }
+static int hle_muldf3(MXLEN_T *x){ set_f64(x,get_f64(x,A0) * get_f64(x,A2)); return 0; }
+static int hle_divdf3(MXLEN_T *x){ set_f64(x,get_f64(x,A0) / get_f64(x,A2)); return 0; }
+static int hle_addsf3(MXLEN_T *x){ set_f32(x,get_f32(x,A0) + get_f32(x,A1)); return 0; }
+static int hle_subsf3(MXLEN_T *x){ set_f32(x,get_f32(x,A0) - get_f32(x,A1)); return 0; }
+static int hle_mulsf3(MXLEN_T *x){ set_f32(x,get_f32(x,A0) * get_f32(x,A1)); return 0; }
+static int hle_divsf3(MXLEN_T *x){ set_f32(x,get_f32(x,A0) / get_f32(x,A1)); return 0; }
+
+static int hle_floatsidf(MXLEN_T *x){ set_f64(x,(double)(int32_t)x[A0]); return 0; }
+static int hle_floatunsidf(MXLEN_T *x){ set_f64(x,(double)(uint32_t)x[A0]); return 0; }
+static int hle_extendsfdf2(MXLEN_T *x){ set_f64(x,(double)get_f32(x,A0)); return 0; }
+
+// 比较函数的返回值与libgcc相同：小于、等于、大于分别为-1，0，1，无序时返回unord
+static int32_t cmp_f64(MXLEN_T *x, int32_t unord){
+    double a = get_f64(x,A0);
+    double b = get_f64(x,A2);
+    if (a != a || b != b)
+        return unord;
+    return (a < b) ? -1 : (a > b);
+}
+
+static int hle_eqdf2(MXLEN_T *x){ x[A0] = (MXLEN_T)(cmp_f64(x,1) != 0); return 0; }
+static int hle_ltdf2(MXLEN_T *x){ x[A0] = (MXLEN_T)cmp_f64(x,2); return 0; }
+static int hle_gtdf2(MXLEN_T *x){ x[A0] = (MXLEN_T)cmp_f64(x,-2); return 0; }
+
+static const HleEntry hle_known[] = {
+    {"memcpy",          hle_memcpy},
+    {"memset",          hle_memset},
+    {"strlen",          hle_strlen},
+    {"memcmp",          hle_memcmp},
+    {"__adddf3",        hle_adddf3},
+    {"__subdf3",        hle_subdf3},
+    {"__muldf3",        hle_muldf3},
+    {"__divdf3",        hle_divdf3},
+    {"__addsf3",        hle_addsf3},
+    {"__subsf3",        hle_subsf3},
+    {"__mulsf3",        hle_mulsf3},
+    {"__divsf3",        hle_divsf3},
+    {"__floatsidf",     hle_floatsidf},
+    {"__floatunsidf",   hle_floatunsidf},
+    {"__extendsfdf2",   hle_extendsfdf2},
+    {"__eqdf2",         hle_eqdf2},
+    {"__nedf2",         hle_eqdf2},
+    {"__ltdf2",         hle_ltdf2},
+    {"__ledf2",         hle_ltdf2},
+    {"__gtdf2",         hle_gtdf2},
+    {"__gedf2",         hle_gtdf2},
+};
+
+int hle_add(const char *name, uint64_t addr)
+{
+    if (hle_stat.hook >= HLE_MAX_HOOK || (addr & 3) != 0 || hle_lookup(addr) != 0)
+        return 0;
+    for (uint32_t k = 0; k < sizeof(hle_known) / sizeof(HleEntry); k++)
+    {
+        if (strcmp(name,hle_known[k].name) != 0)
+            continue;
+        uint8_t id = (uint8_t)(hle_stat.hook + 1);
+        uint32_t i = (uint32_t)((addr >> 2) & (HLE_HASH_SIZE - 1));
+        while (hle_id[i] != 0)
+            i = (i + 1) & (HLE_HASH_SIZE - 1);
+        hle_addr[i] = addr;
+        hle_id[i] = id;
+        hook_func[id] = hle_known[k].func;
+        hle_stat.hook += 1;
+        hle_num += 1;
+        return 1;
+    }
+    return 0;
+}
+
+int hle_call(uint8_t id, MXLEN_T *x)
+{
+    if (hook_func[id](x) != 0) {
+        hle_stat.fallback += 1;
+        return 1;
+    }
+    hle_stat.call += 1;
+    return 0;
+}
+
+HleStat* get_hle_stat()
+{
+    return &hle_stat;
+}
@@ -0,0 +1,77 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// 函数级的高层模拟（HLE）
+// 从ELF的符号表中找到常用库函数的入口，执行到入口时由host的实现一次完成，然后从ra返回
+// 支持memcpy，memset，strlen，memcmp，以及软件浮点库中double和float的四则运算、比较和转换
+// host实现只写入返回值a0（和a1），不会像guest的实现一样改写其他临时寄存器，整个调用计为一条指令
+// 访问范围不全在DRAM中，写到了已经译码或者翻译过的页，memcpy的源和目的重叠，或者返回地址不对齐时，
+// 仍然由guest的代码执行
+
+#ifndef __HLE_H__
+    #define __HLE_H__
+
+#include <stdint.h>
+#include "cpu_config.h"
+
+#define HLE_MAX_HOOK  32    // 最多的入口数
+#define HLE_HASH_SIZE 64    // 入口地址哈希表的大小，必须是2的幂，并且大于HLE_MAX_HOOK
+
+typedef struct hle_stat_t
+{
+    uint64_t hook;      // 注册的入口数
+    uint64_t call;      // 由host完成的调用数
+    uint64_t fallback;  // 不满足条件，由guest代码执行的次数
+} HleStat;
+
+// 以入口地址为key的开放寻址哈希表，hle_id为0表示空位
+// 只在加载程序时写入，执行引擎在跳转目标上查询
+extern uint64_t hle_addr[HLE_HASH_SIZE];
+extern uint8_t  hle_id[HLE_HASH_SIZE];
+// 注册的入口数，为0时执行引擎不需要查表
+extern uint32_t hle_num;
+
+// 返回pc处注册的入口编号，没有时返回0
+static inline uint8_t hle_lookup(uint64_t pc){
+    uint32_t i = (uint32_t)((pc >> 2) & (HLE_HASH_SIZE - 1));
+    while (hle_id[i] != 0)
+    {
+        if (hle_addr[i] == pc)
+            return hle_id[i];
+        i = (i + 1) & (HLE_HASH_SIZE - 1);
+    }
+    return 0;
+}
+
+// 函数名是支持的函数时，注册addr为它的入口，返回1；否则返回0
+// 参数的类型与read_func_sym()的回调相同
+int hle_add(const char *name, uint64_t addr);
+
+// 执行编号为id的入口，x为通用寄存器
+// 成功时返回0，只写入了返回值，调用者负责跳转到ra；返回非0时需要由guest代码执行
+int hle_call(uint8_t id, MXLEN_T *x);
+
+HleStat* get_hle_stat();
+
+#endif //__HLE_H__
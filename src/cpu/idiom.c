@@ -0,0 +1,271 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "idiom.h"
+#include "guest_mem.h"
+#include "../dev/dev_config.h"
+
+static IdiomStat idiom_stat;
+
+// load和store的访问字节数，不是访存指令时返回0
+static uint8_t load_size(uint8_t id){
+    switch (id)
+    {
+    case INST_LB: case INST_LBU: return 1;
+    case INST_LH: case INST_LHU: return 2;
+    case INST_LW:                return 4;
+    default:                     return 0;
+    }
+}
+
+static uint8_t store_size(uint8_t id){
+    switch (id)
+    {
+    case INST_SB: return 1;
+    case INST_SH: return 2;
+    case INST_SW: return 4;
+    default:      return 0;
+    }
+}
+
+// 结尾分支比较的两个寄存器中，一个是ptr之一，另一个作为结束地址
+// bltu只能是 ptr < end 时继续循环
+static int match_branch(const DecInst *br, uint8_t p0, uint8_t p1, Idiom *idiom){
+    if ((br->rs1 == p0 || br->rs1 == p1) && br->rs2 != p0 && br->rs2 != p1) {
+        idiom->cmp = br->rs1;
+        idiom->end = br->rs2;
+        return 1;
+    }
+    if (br->id == INST_BNE && (br->rs2 == p0 || br->rs2 == p1) && br->rs1 != p0 && br->rs1 != p1) {
+        idiom->cmp = br->rs2;
+        idiom->end = br->rs1;
+        return 1;
+    }
+    return 0;
+}
+
+void idiom_match(uint64_t pc, const DecInst *const *dec, uint32_t inst_num, Idiom *idiom)
+{
+    memset(idiom,0,sizeof(Idiom));
+    // 循环体最多是两次访存和两次指针的递增
+    if (inst_num < 3 || inst_num > 5)
+        return;
+    const DecInst *br = dec[inst_num - 1];
+    if (br->id != INST_BNE && br->id != INST_BLTU)
+        return;
+    if (pc + 4 * (inst_num - 1) + (int64_t)br->imm != pc)
+        return;
+
+    int ld = -1, st = -1;
+    int add[2];
+    uint32_t add_num = 0;
+    for (uint32_t i = 0; i + 1 < inst_num; i++)
+    {
+        const DecInst *d = dec[i];
+        if (load_size(d->id) && ld < 0)
+            ld = i;
+        else if (store_size(d->id) && st < 0)
+            st = i;
+        else if (d->id == INST_ADDI && d->rd == d->rs1 && d->rd != 0 && add_num < 2)
+            add[add_num++] = i;
+        else
+            return;
+    }
+
+    if (ld >= 0 && st < 0 && add_num == 1)
+    {
+        // SCAN：lb/lbu t, off(p); addi p, p, 1; bne t, x0
+        const DecInst *l = dec[ld];
+        const DecInst *a = dec[add[0]];
+        uint8_t p = l->rs1;
+        uint8_t t = l->rd;
+        if (load_size(l->id) != 1 || a->rd != p || a->imm != 1 || t == 0 || t == p)
+            return;
+        if (br->id != INST_BNE || !((br->rs1 == t && br->rs2 == 0) || (br->rs1 == 0 && br->rs2 == t)))
+            return;
+        idiom->size = 1;
+        idiom->src = p;
+        idiom->val = t;
+        idiom->src_off = l->imm + (add[0] < ld ? 1 : 0);
+        idiom->ld_id = l->id;
+        idiom->kind = IDIOM_SCAN;
+    }
+    else if (ld < 0 && st >= 0 && add_num == 1)
+    {
+        // FILL：store v, off(p); addi p, p, size; bne/bltu p, end
+        const DecInst *s = dec[st];
+        const DecInst *a = dec[add[0]];
+        uint8_t p = s->rs1;
+        uint8_t size = store_size(s->id);
+        if (a->rd != p || a->imm != size || s->rs2 == p)
+            return;
+        if (!match_branch(br,p,p,idiom))
+            return;
+        idiom->size = size;
+        idiom->dst = p;
+        idiom->val = s->rs2;
+        idiom->dst_off = s->imm + (add[0] < st ? size : 0);
+        idiom->kind = IDIOM_FILL;
+    }
+    else if (ld >= 0 && st > ld && add_num == 2)
+    {
+        // COPY：load t, off(s); store t, off(d); addi s, s, size; addi d, d, size; bne/bltu s或d, end
+        const DecInst *l = dec[ld];
+        const DecInst *s = dec[st];
+        uint8_t src = l->rs1;
+        uint8_t dst = s->rs1;
+        uint8_t t = l->rd;
+        uint8_t size = load_size(l->id);
+        if (size != store_size(s->id) || s->rs2 != t || t == 0 || src == dst || t == src || t == dst)
+            return;
+        int add_s = (dec[add[0]]->rd == src) ? add[0] : add[1];
+        int add_d = (dec[add[0]]->rd == dst) ? add[0] : add[1];
+        if (add_s == add_d || dec[add_s]->rd != src || dec[add_d]->rd != dst)
+            return;
+        if (dec[add_s]->imm != size || dec[add_d]->imm != size)
+            return;
+        if (!match_branch(br,src,dst,idiom) || idiom->end == t)
+            return;
+        idiom->size = size;
+        idiom->src = src;
+        idiom->dst = dst;
+        idiom->val = t;
+        idiom->src_off = l->imm + (add_s < ld ? size : 0);
+        idiom->dst_off = s->imm + (add_d < st ? size : 0);
+        idiom->ld_id = l->id;
+        idiom->kind = IDIOM_COPY;
+    }
+    else
+        return;
+    idiom->br_id = br->id;
+    idiom_stat.match += 1;
+}
+
+// ----------------------------------------------
+// 执行
+// ----------------------------------------------
+// 与load指令相同的扩展方式读取一个元素
+static MXLEN_T load_elem(uint64_t addr, uint8_t ld_id){
+    uint32_t v = gmem_read(addr,load_size(ld_id));
+    switch (ld_id)
+    {
+    case INST_LB: return (MXLEN_T)(int32_t)(int8_t)v;
+    case INST_LH: return (MXLEN_T)(int32_t)(int16_t)v;
+    default:      return (MXLEN_T)v;
+    }
+}
+
+// 分支比较的指针每次迭代增加size，返回循环结束时的迭代数，无法确定时返回0
+static uint64_t loop_iter(const Idiom *idiom, MXLEN_T *x){
+    MXLEN_T c0 = x[idiom->cmp];
+    MXLEN_T e = x[idiom->end];
+    if (idiom->br_id == INST_BNE) {
+        MXLEN_T dist = e - c0;
+        if (dist == 0 || dist % idiom->size != 0)
+            return 0;
+        return dist / idiom->size;
+    }
+    // bltu，指针不能回绕
+    if (c0 >= e)
+        return 0;
+    uint64_t n = ((uint64_t)(e - c0) + idiom->size - 1) / idiom->size;
+    if ((uint64_t)c0 + n * idiom->size > (MXLEN_T)(-1))
+        return 0;
+    return n;
+}
+
+static uint64_t copy_exec(const Idiom *idiom, MXLEN_T *x, uint64_t n){
+    uint64_t src = (MXLEN_T)(x[idiom->src] + idiom->src_off);
+    uint64_t dst = (MXLEN_T)(x[idiom->dst] + idiom->dst_off);
+    uint64_t len = n * idiom->size;
+    if (!gmem_is_dram(src,len) || !gmem_is_dram(dst,len) || !gmem_writable(dst,len))
+        return 0;
+    // 目的在源之后并且重叠时，逐个元素复制会读到已经写入的数据，结果与memmove不同
+    if (dst > src && dst < src + len)
+        return 0;
+    // 最后一次迭代先load再store，目的不在源之后时，之前的迭代不会改写最后一个元素的源
+    x[idiom->val] = load_elem(src + len - idiom->size,idiom->ld_id);
+    gmem_move(dst,src,len);
+    x[idiom->src] += (MXLEN_T)len;
+    x[idiom->dst] += (MXLEN_T)len;
+    return n;
+}
+
+static uint64_t fill_exec(const Idiom *idiom, MXLEN_T *x, uint64_t n){
+    uint64_t dst = (MXLEN_T)(x[idiom->dst] + idiom->dst_off);
+    uint64_t len = n * idiom->size;
+    if (!gmem_is_dram(dst,len) || !gmem_writable(dst,len))
+        return 0;
+    gmem_fill(dst,(uint32_t)x[idiom->val],idiom->size,len);
+    x[idiom->dst] += (MXLEN_T)len;
+    return n;
+}
+
+static uint64_t scan_exec(const Idiom *idiom, MXLEN_T *x, uint64_t max_iter, uint8_t *done){
+    uint64_t src = (MXLEN_T)(x[idiom->src] + idiom->src_off);
+    if (!gmem_is_dram(src,1))
+        return 0;
+    // 超出DRAM的部分由执行引擎执行，产生访问错误
+    uint64_t limit = (uint64_t)DRAM_END + 1 - src;
+    if (limit > max_iter)
+        limit = max_iter;
+    uint64_t n = gmem_find(src,0,limit);
+    *done = (n < limit);
+    if (*done)
+        n += 1;
+    x[idiom->val] = load_elem(src + n - 1,idiom->ld_id);
+    x[idiom->src] += (MXLEN_T)n;
+    return n;
+}
+
+uint64_t idiom_execute(const Idiom *idiom, MXLEN_T *x, uint64_t max_iter, uint8_t *done)
+{
+    uint64_t n = 0;
+    if (max_iter == 0)
+        return 0;
+    if (idiom->kind == IDIOM_SCAN)
+        n = scan_exec(idiom,x,max_iter,done);
+    else {
+        uint64_t total = loop_iter(idiom,x);
+        n = (total < max_iter) ? total : max_iter;
+        *done = (n == total);
+        if (n > 0 && idiom->kind == IDIOM_COPY)
+            n = copy_exec(idiom,x,n);
+        else if (n > 0)
+            n = fill_exec(idiom,x,n);
+    }
+    if (n == 0)
+        idiom_stat.fallback += 1;
+    else
+        idiom_stat.exec += 1;
+    return n;
+}
+
+IdiomStat* get_idiom_stat()
+{
+    return &idiom_stat;
+}
@@ -0,0 +1,84 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// 循环模式识别
+// 翻译基本块时检查它是否是一个只有一个基本块的循环，并且属于以下几种常见的模式：
+//   COPY：逐个元素复制，load t, (s); store t, (d); s += size; d += size; bne/bltu s或d, end
+//   FILL：逐个元素填充，store v, (p); p += size; bne/bltu p, end
+//   SCAN：查找字符串的结尾，lb/lbu t, (p); p += 1; bnez t
+// 指令的顺序不限，load和store可以带offset
+// 执行到这样的基本块时，由host的memmove，memset和memchr一次完成所有的迭代，并写入与逐条执行相同的寄存器结果
+// 访问范围不全在DRAM中，写到了已经译码或者翻译过的页，或者复制的源和目的以会改变结果的方式重叠时，
+// 仍然由执行引擎逐条执行
+
+#ifndef __IDIOM_H__
+    #define __IDIOM_H__
+
+#include <stdint.h>
+#include "cpu_config.h"
+#include "predecode.h"
+
+typedef enum {
+    IDIOM_NONE = 0,
+    IDIOM_COPY = 1,
+    IDIOM_FILL = 2,
+    IDIOM_SCAN = 3
+} IdiomKind;
+
+// 识别出的循环，访问地址都表示为迭代开始时指针的值加上off
+typedef struct idiom_t
+{
+    uint8_t kind;       // IdiomKind
+    uint8_t size;       // 每次访问的字节数
+    uint8_t ld_id;      // load的InstID，用于计算t的最终值
+    uint8_t br_id;      // 结尾分支的InstID
+    uint8_t src;        // COPY：源指针；SCAN：扫描的指针
+    uint8_t dst;        // COPY，FILL：目的指针
+    uint8_t val;        // COPY，SCAN：load的目的寄存器；FILL：填充的值
+    uint8_t cmp;        // 分支比较的指针
+    uint8_t end;        // 分支比较的结束地址
+    int32_t src_off;
+    int32_t dst_off;
+} Idiom;
+
+typedef struct idiom_stat_t
+{
+    uint64_t match;     // 识别出的循环数
+    uint64_t exec;      // 由host一次完成的次数
+    uint64_t inst;      // 由host完成的指令数
+    uint64_t fallback;  // 不满足条件，由执行引擎逐条执行的次数
+} IdiomStat;
+
+// 检查pc开始的inst_num条指令是否是可以识别的循环，结果写入idiom
+// 不能识别时idiom->kind为IDIOM_NONE
+void idiom_match(uint64_t pc, const DecInst *const *dec, uint32_t inst_num, Idiom *idiom);
+
+// 执行识别出的循环，最多执行max_iter次迭代，x为通用寄存器
+// 返回执行的迭代数，返回0时需要由执行引擎逐条执行
+// *done为1表示循环已经结束，否则还需要从循环的起始地址继续执行
+uint64_t idiom_execute(const Idiom *idiom, MXLEN_T *x, uint64_t max_iter, uint8_t *done);
+
+IdiomStat* get_idiom_stat();
+
+#endif //__IDIOM_H__
@@ -0,0 +1,1272 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jit_x64.h"
+#include "block_cache.h"
+#include "predecode.h"
+#include "../dev/memory.h"
+#include "../dev/mem_pool.h"
+#include "../dev/dev_config.h"
+#include "../include/comm.h"
+
+
+static JitStat jit_stat;
+
+uint32_t jit_tier_hot[JIT_TIER_NUM] = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+
+// ----------------------------------------------
+// load/store 辅助函数
+// ----------------------------------------------
+// JIT和AOT生成的本地代码共用，不依赖host的指令集
+// 与解释器共用软件TLB，见memory.h
+
+// load返回JIT_LD_FAULT表示访问出错
+// store返回JIT_ST_INVAL表示写到了已经翻译的代码，有基本块已经失效
+//   返回JIT_ST_FAULT表示访问出错，没有写入任何数据
+uint64_t jit_lb(uint32_t addr){
+    uint8_t data;
+    if (mem_read_u8(addr,CPU_BE,&data) != 0)
+        return JIT_LD_FAULT;
+    return (uint32_t)(int32_t)(int8_t)data;
+}
+uint64_t jit_lh(uint32_t addr){
+    uint16_t data;
+    if (mem_read_u16(addr,CPU_BE,&data) != 0)
+        return JIT_LD_FAULT;
+    return (uint32_t)(int32_t)(int16_t)data;
+}
+uint64_t jit_lw(uint32_t addr){
+    uint32_t data;
+    if (mem_read_u32(addr,CPU_BE,&data) != 0)
+        return JIT_LD_FAULT;
+    return data;
+}
+uint64_t jit_lbu(uint32_t addr){
+    uint8_t data;
+    if (mem_read_u8(addr,CPU_BE,&data) != 0)
+        return JIT_LD_FAULT;
+    return data;
+}
+uint64_t jit_lhu(uint32_t addr){
+    uint16_t data;
+    if (mem_read_u16(addr,CPU_BE,&data) != 0)
+        return JIT_LD_FAULT;
+    return data;
+}
+int jit_sb(uint32_t addr, uint32_t data){
+    uint64_t gen = blk_cache_gen();
+    if (mem_write_u8(addr,CPU_BE,(uint8_t)data) != 0)
+        return JIT_ST_FAULT;
+    return (blk_cache_gen() != gen) ? JIT_ST_INVAL : JIT_ST_OK;
+}
+int jit_sh(uint32_t addr, uint32_t data){
+    uint64_t gen = blk_cache_gen();
+    if (mem_write_u16(addr,CPU_BE,(uint16_t)data) != 0)
+        return JIT_ST_FAULT;
+    return (blk_cache_gen() != gen) ? JIT_ST_INVAL : JIT_ST_OK;
+}
+int jit_sw(uint32_t addr, uint32_t data){
+    uint64_t gen = blk_cache_gen();
+    if (mem_write_u32(addr,CPU_BE,data) != 0)
+        return JIT_ST_FAULT;
+    return (blk_cache_gen() != gen) ? JIT_ST_INVAL : JIT_ST_OK;
+}
+
+#ifdef JIT_SUPPORT
+
+#include <time.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#define JIT_INST_CODE_MAX   320 // 单条指令生成代码的上限，每个出口都需要写回寄存器
+
+// x86-64 寄存器编号
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RBP 5
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+#define R15 15
+
+#define JIT_ALLOC_REGS 5
+
+// 条件码
+#define CC_B    0x2
+#define CC_AE   0x3
+#define CC_E    0x4
+#define CC_NE   0x5
+#define CC_L    0xc
+#define CC_GE   0xd
+
+static uint8_t *code_base;
+static uint64_t code_used;
+static uint64_t code_gen;   // 代码缓存对应的基本块缓存清空的版本
+static uint8_t  code_full;
+static __thread uint8_t *cp;// 当前的写入位置，每个编译线程独立
+
+// ----------------------------------------------
+// 指令编码
+// ----------------------------------------------
+// 编译过程中guest寄存器的状态
+// baseline层所有寄存器都在x[]中，优化层会将常用的寄存器放在host寄存器中，
+// 并记录值已知的寄存器，只在需要时才生成代码
+typedef struct jit_ctx_t
+{
+    uint8_t  tier;
+    uint8_t  host_num;      // 分配的host寄存器数
+    int8_t   host[32];      // 分配的host寄存器，-1表示在x[]中
+    uint8_t  dirty[32];     // host寄存器中的值比x[]中的新
+    uint8_t  is_const[32];  // 值在编译时已知
+    uint32_t cval[32];
+    uint32_t inst;          // 编译的指令数
+    uint32_t const_fold;    // 以下为本次编译的统计，编译完成后计入jit_stat
+    uint32_t dead_write;
+    uint32_t host_reg;
+} JitCtx;
+
+static __thread JitCtx jc;
+
+// 编译的输入，从基本块中复制，后台线程编译时不访问基本块缓存
+typedef struct jit_src_t
+{
+    uint32_t pc;
+    uint32_t inst_num;
+    DecInst  dec[TRACE_MAX_INST];
+    uint32_t trace_next[TRACE_MAX_INST];   // 不为0时，指令是superblock内部基本块的结尾，值为路径上下一个基本块的地址
+} JitSrc;
+
+// 优化层可以使用的host寄存器，都是callee-saved，调用辅助函数时不需要保存
+static const uint8_t alloc_regs [JIT_ALLOC_REGS] = {RBP, R12, R13, R14, R15};
+
+static inline void emit_u8(uint8_t v){
+    *cp++ = v;
+}
+static inline void emit_u32(uint32_t v){
+    memcpy(cp,&v,4);
+    cp += 4;
+}
+static inline void emit_u64(uint64_t v){
+    memcpy(cp,&v,8);
+    cp += 8;
+}
+
+static inline void emit_rex(uint8_t w, uint8_t r, uint8_t b){
+    uint8_t rex = 0x40 | (w << 3) | ((r >> 3) << 2) | (b >> 3);
+    if (rex != 0x40)
+        emit_u8(rex);
+}
+
+// mov dst32, src32
+static void emit_mov_rr(uint8_t dst, uint8_t src){
+    if (dst == src)
+        return;
+    emit_rex(0,src,dst);
+    emit_u8(0x89);
+    emit_u8(0xc0 | ((src & 7) << 3) | (dst & 7));
+}
+
+// mov reg32, imm32
+static void emit_mov_ri(uint8_t reg, uint32_t imm){
+    emit_rex(0,0,reg);
+    emit_u8(0xb8 | (reg & 7));
+    emit_u32(imm);
+}
+
+// mov reg32, x[r]
+static void emit_mov_rm(uint8_t reg, uint8_t r){
+    emit_rex(0,reg,0);
+    emit_u8(0x8b);
+    emit_u8(0x43 | ((reg & 7) << 3));
+    emit_u8(r * 4);
+}
+
+// mov x[r], reg32
+static void emit_mov_mr(uint8_t r, uint8_t reg){
+    emit_rex(0,reg,0);
+    emit_u8(0x89);
+    emit_u8(0x43 | ((reg & 7) << 3));
+    emit_u8(r * 4);
+}
+
+// mov dword x[r], imm32
+static void emit_mov_mi(uint8_t r, uint32_t imm){
+    emit_u8(0xc7);
+    emit_u8(0x43);
+    emit_u8(r * 4);
+    emit_u32(imm);
+}
+
+// 读取guest寄存器到scratch寄存器
+// 与解释器一样，x0也从x[]中读取
+static void emit_ld(uint8_t reg, uint8_t r){
+    if (jc.is_const[r])
+        emit_mov_ri(reg,jc.cval[r]);
+    else if (jc.host[r] >= 0)
+        emit_mov_rr(reg,(uint8_t)jc.host[r]);
+    else
+        emit_mov_rm(reg,r);
+}
+
+// 写guest寄存器，rd为0时不写
+static void emit_st(uint8_t reg, uint8_t rd){
+    if (rd == 0)
+        return;
+    jc.is_const[rd] = 0;
+    if (jc.host[rd] >= 0) {
+        emit_mov_rr((uint8_t)jc.host[rd],reg);
+        jc.dirty[rd] = 1;
+    }
+    else
+        emit_mov_mr(rd,reg);
+}
+
+// 写guest寄存器，rd为0时也会写入x[0]，只用于和解释器保持一致的特殊情况
+static void emit_st_force(uint8_t reg, uint8_t rd){
+    if (rd == 0)
+        emit_mov_mr(0,reg);
+    else
+        emit_st(reg,rd);
+}
+
+static void emit_st_imm_force(uint8_t rd, uint32_t imm){
+    jc.is_const[rd] = 0;
+    if (rd != 0 && jc.host[rd] >= 0) {
+        emit_mov_ri((uint8_t)jc.host[rd],imm);
+        jc.dirty[rd] = 1;
+    }
+    else
+        emit_mov_mi(rd,imm);
+}
+
+// 写入编译时已知的值，优化层只记录，需要时再生成代码
+static void emit_set_imm(uint8_t rd, uint32_t imm){
+    if (rd == 0)
+        return;
+    if (jc.tier == JIT_TIER_OPT) {
+        jc.is_const[rd] = 1;
+        jc.cval[rd] = imm;
+    }
+    else
+        emit_mov_mi(rd,imm);
+}
+
+// op eax, ecx
+static void emit_alu_rr(uint8_t opcode){
+    emit_u8(opcode);
+    emit_u8(0xc8);
+}
+
+// op eax, imm32
+static void emit_alu_ri(uint8_t opcode, uint32_t imm){
+    emit_u8(opcode);
+    emit_u32(imm);
+}
+
+// call fn
+static void emit_call(void *fn){
+    emit_u8(0x48); emit_u8(0xb8); emit_u64((uint64_t)fn);   // mov rax, imm64
+    emit_u8(0xff); emit_u8(0xd0);                           // call rax
+}
+
+// 短跳转，返回需要回填的位置
+static uint8_t* emit_jcc8(uint8_t cc){
+    emit_u8(0x70 | cc);
+    emit_u8(0);
+    return cp - 1;
+}
+static uint8_t* emit_jmp8(){
+    emit_u8(0xeb);
+    emit_u8(0);
+    return cp - 1;
+}
+static void patch8(uint8_t *loc){
+    *loc = (uint8_t)(cp - (loc + 1));
+}
+
+// 跳过返回代码时使用32位偏移，写回寄存器的代码可能超过128字节
+static uint8_t* emit_jcc32(uint8_t cc){
+    emit_u8(0x0f);
+    emit_u8(0x80 | cc);
+    emit_u32(0);
+    return cp - 4;
+}
+static void patch32(uint8_t *loc){
+    uint32_t rel = (uint32_t)(cp - (loc + 4));
+    memcpy(loc,&rel,4);
+}
+
+static void emit_prologue(){
+    emit_u8(0x53);                                  // push rbx
+    // 只保存分配了的host寄存器
+    for (uint32_t i = 0; i < jc.host_num; i++)
+    {
+        emit_rex(0,0,alloc_regs[i]);
+        emit_u8(0x50 | (alloc_regs[i] & 7));        // push reg
+    }
+    if (jc.host_num & 1) {
+        emit_u8(0x48); emit_u8(0x83); emit_u8(0xec); emit_u8(8); // sub rsp, 8，保持栈对齐
+    }
+    emit_u8(0x48); emit_u8(0x89); emit_u8(0xfb);    // mov rbx, rdi
+    for (uint8_t r = 1; r < 32; r++)
+    {
+        if (jc.host[r] >= 0)
+            emit_mov_rm((uint8_t)jc.host[r],r);
+    }
+}
+
+// 将host寄存器和编译时已知的值写回x[]，只在返回路径上生成，不改变编译状态
+static void emit_writeback(){
+    for (uint8_t r = 1; r < 32; r++)
+    {
+        if (jc.is_const[r])
+            emit_mov_mi(r,jc.cval[r]);
+        else if (jc.host[r] >= 0 && jc.dirty[r])
+            emit_mov_mr(r,(uint8_t)jc.host[r]);
+    }
+}
+
+static void emit_epilogue(){
+    if (jc.host_num & 1) {
+        emit_u8(0x48); emit_u8(0x83); emit_u8(0xc4); emit_u8(8); // add rsp, 8
+    }
+    for (int i = (int)jc.host_num - 1; i >= 0; i--)
+    {
+        emit_rex(0,0,alloc_regs[i]);
+        emit_u8(0x58 | (alloc_regs[i] & 7));        // pop reg
+    }
+    emit_u8(0x5b);                                  // pop rbx
+    emit_u8(0xc3);                                  // ret
+}
+
+// 返回 {next_pc, retired}
+static void emit_exit(uint32_t next_pc, uint32_t retired){
+    emit_writeback();
+    emit_u8(0xb8); emit_u32(next_pc);   // mov eax, next_pc
+    emit_u8(0xba); emit_u32(retired);   // mov edx, retired
+    emit_epilogue();
+}
+
+// next_pc已经在eax中
+static void emit_exit_eax(uint32_t retired){
+    emit_writeback();
+    emit_u8(0xba); emit_u32(retired);
+    emit_epilogue();
+}
+
+static inline int misaligned(uint32_t target){
+    return (target & ((IALIGN == 32) ? 0b11 : 0b01)) > 0;
+}
+
+// 除法和取余，与execution.h中的实现保持一致
+// 除数为0或者溢出时，即使rd为0也会写入
+static void emit_div(const DecInst *d){
+    uint8_t is_signed = (d->id == INST_DIV || d->id == INST_REM);
+    uint8_t is_rem    = (d->id == INST_REM || d->id == INST_REMU);
+    uint8_t *to_zero, *to_norm, *to_ovf, *end_0, *end_1;
+
+    emit_ld(RAX,d->rs1);
+    emit_ld(RCX,d->rs2);
+    emit_u8(0x85); emit_u8(0xc9);                   // test ecx, ecx
+    to_zero = emit_jcc8(CC_E);
+    if (is_signed) {
+        emit_u8(0x83); emit_u8(0xf9); emit_u8(0xff);// cmp ecx, -1
+        to_norm = emit_jcc8(CC_NE);
+        emit_alu_ri(0x3d,0x80000000);               // cmp eax, 0x80000000
+        to_ovf = emit_jcc8(CC_E);
+        patch8(to_norm);
+        emit_u8(0x99);                              // cdq
+        emit_u8(0xf7); emit_u8(0xf9);               // idiv ecx
+    }
+    else {
+        emit_u8(0x31); emit_u8(0xd2);               // xor edx, edx
+        emit_u8(0xf7); emit_u8(0xf1);               // div ecx
+    }
+    emit_st(is_rem ? RDX : RAX,d->rd);
+    end_0 = emit_jmp8();
+    // 除数为0
+    patch8(to_zero);
+    if (is_rem)
+        emit_st_force(RAX,d->rd);
+    else
+        emit_st_imm_force(d->rd,0xffffffff);
+    if (is_signed) {
+        end_1 = emit_jmp8();
+        // 溢出
+        patch8(to_ovf);
+        emit_st_imm_force(d->rd,is_rem ? 0 : 0x80000000);
+        patch8(end_1);
+    }
+    patch8(end_0);
+}
+
+// 优化层：源操作数都已知时，在编译时计算结果
+// 返回1表示已经完成计算
+static int fold_const(const DecInst *d){
+    uint32_t a, b, v;
+    uint8_t c1 = jc.is_const[d->rs1];
+    uint8_t c2 = jc.is_const[d->rs2];
+    a = jc.cval[d->rs1];
+    b = jc.cval[d->rs2];
+
+    switch (d->id)
+    {
+    case INST_ADD: case INST_SUB: case INST_XOR: case INST_OR: case INST_AND:
+    case INST_SLL: case INST_SRL: case INST_SRA: case INST_SLT: case INST_SLTU:
+    case INST_MUL:
+        if (!c1 || !c2)
+            return 0;
+        if (d->id == INST_ADD)       v = a + b;
+        else if (d->id == INST_SUB)  v = a - b;
+        else if (d->id == INST_XOR)  v = a ^ b;
+        else if (d->id == INST_OR)   v = a | b;
+        else if (d->id == INST_AND)  v = a & b;
+        else if (d->id == INST_SLL)  v = a << (b & 0x1f);
+        else if (d->id == INST_SRL)  v = a >> (b & 0x1f);
+        else if (d->id == INST_SRA)  v = (uint32_t)((int32_t)a >> (b & 0x1f));
+        else if (d->id == INST_SLT)  v = ((int32_t)a < (int32_t)b);
+        else if (d->id == INST_SLTU) v = (a < b);
+        else                         v = a * b;
+        break;
+    case INST_ADDI: case INST_XORI: case INST_ORI: case INST_ANDI:
+    case INST_SLTI: case INST_SLTIU: case INST_SLLI: case INST_SRLI: case INST_SRAI:
+        if (!c1)
+            return 0;
+        b = (uint32_t)d->imm;
+        if (d->id == INST_ADDI)       v = a + b;
+        else if (d->id == INST_XORI)  v = a ^ b;
+        else if (d->id == INST_ORI)   v = a | b;
+        else if (d->id == INST_ANDI)  v = a & b;
+        else if (d->id == INST_SLTI)  v = ((int32_t)a < (int32_t)b);
+        else if (d->id == INST_SLTIU) v = (a < b);
+        else if (d->id == INST_SLLI)  v = a << b;
+        else if (d->id == INST_SRLI)  v = a >> b;
+        else                          v = (uint32_t)((int32_t)a >> b);
+        break;
+    default:
+        return 0;
+    }
+    emit_set_imm(d->rd,v);
+    jc.const_fold += 1;
+    return 1;
+}
+
+// 编译一条指令
+// trace_next不为0时，指令是superblock内部基本块的结尾，trace_next为路径上下一个基本块的地址
+// 返回0表示无法编译，返回1表示编译完成，返回2表示编译完成且已经生成了返回代码
+static int emit_inst(const DecInst *d, uint32_t pc, uint32_t retired, uint32_t trace_next){
+    uint32_t target;
+    uint8_t *loc, *fault;
+    uint8_t cc;
+
+    if (jc.tier == JIT_TIER_OPT && d->rd != 0 && fold_const(d))
+        return 1;
+
+    switch (d->id)
+    {
+    // OP_32
+    case INST_ADD: case INST_SUB: case INST_XOR: case INST_OR: case INST_AND:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        emit_ld(RCX,d->rs2);
+        if (d->id == INST_ADD)      emit_alu_rr(0x01);
+        else if (d->id == INST_SUB) emit_alu_rr(0x29);
+        else if (d->id == INST_XOR) emit_alu_rr(0x31);
+        else if (d->id == INST_OR)  emit_alu_rr(0x09);
+        else                        emit_alu_rr(0x21);
+        emit_st(RAX,d->rd);
+        return 1;
+    case INST_SLL: case INST_SRL: case INST_SRA:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        emit_ld(RCX,d->rs2);
+        emit_u8(0xd3);                              // shl/shr/sar eax, cl
+        emit_u8(d->id == INST_SLL ? 0xe0 : (d->id == INST_SRL ? 0xe8 : 0xf8));
+        emit_st(RAX,d->rd);
+        return 1;
+    case INST_SLT: case INST_SLTU:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        emit_ld(RCX,d->rs2);
+        emit_u8(0x31); emit_u8(0xd2);               // xor edx, edx
+        emit_u8(0x39); emit_u8(0xc8);               // cmp eax, ecx
+        emit_u8(0x0f); emit_u8(d->id == INST_SLT ? 0x9c : 0x92); emit_u8(0xc2); // setl/setb dl
+        emit_st(RDX,d->rd);
+        return 1;
+    // M extension
+    case INST_MUL:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        emit_ld(RCX,d->rs2);
+        emit_u8(0x0f); emit_u8(0xaf); emit_u8(0xc1); // imul eax, ecx
+        emit_st(RAX,d->rd);
+        return 1;
+    case INST_MULH: case INST_MULHU:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        emit_ld(RCX,d->rs2);
+        emit_u8(0xf7); emit_u8(d->id == INST_MULH ? 0xe9 : 0xe1); // imul/mul ecx
+        emit_st(RDX,d->rd);
+        return 1;
+    case INST_MULHSU:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        emit_ld(RCX,d->rs2);
+        emit_u8(0x48); emit_u8(0x63); emit_u8(0xc0);                   // movsxd rax, eax
+        emit_u8(0x48); emit_u8(0x0f); emit_u8(0xaf); emit_u8(0xc1);    // imul rax, rcx
+        emit_u8(0x48); emit_u8(0xc1); emit_u8(0xe8); emit_u8(32);      // shr rax, 32
+        emit_st(RAX,d->rd);
+        return 1;
+    case INST_DIV: case INST_DIVU: case INST_REM: case INST_REMU:
+        emit_div(d);
+        return 1;
+    // OP_IMM
+    case INST_ADDI: case INST_XORI: case INST_ORI: case INST_ANDI:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        if (d->id == INST_ADDI)      emit_alu_ri(0x05,(uint32_t)d->imm);
+        else if (d->id == INST_XORI) emit_alu_ri(0x35,(uint32_t)d->imm);
+        else if (d->id == INST_ORI)  emit_alu_ri(0x0d,(uint32_t)d->imm);
+        else                         emit_alu_ri(0x25,(uint32_t)d->imm);
+        emit_st(RAX,d->rd);
+        return 1;
+    case INST_SLTI: case INST_SLTIU:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        emit_u8(0x31); emit_u8(0xd2);               // xor edx, edx
+        emit_alu_ri(0x3d,(uint32_t)d->imm);         // cmp eax, imm32
+        emit_u8(0x0f); emit_u8(d->id == INST_SLTI ? 0x9c : 0x92); emit_u8(0xc2);
+        emit_st(RDX,d->rd);
+        return 1;
+    case INST_SLLI: case INST_SRLI: case INST_SRAI:
+        if (d->rd == 0)
+            return 1;
+        emit_ld(RAX,d->rs1);
+        emit_u8(0xc1);                              // shl/shr/sar eax, imm8
+        emit_u8(d->id == INST_SLLI ? 0xe0 : (d->id == INST_SRLI ? 0xe8 : 0xf8));
+        emit_u8((uint8_t)d->imm);
+        emit_st(RAX,d->rd);
+        return 1;
+    // load imme
+    case INST_LUI:
+        emit_set_imm(d->rd,(uint32_t)d->imm);
+        return 1;
+    case INST_AUIPC:
+        emit_set_imm(d->rd,pc + (uint32_t)d->imm);
+        return 1;
+    // MISC_MEM
+    case INST_NOP: case INST_WFI: case INST_FENCE: case INST_FENCE_TSO:
+    case INST_PAUSE:
+        return 1;
+    // LOAD
+    case INST_LB: case INST_LH: case INST_LW: case INST_LBU: case INST_LHU:
+        emit_ld(RDI,d->rs1);
+        if (d->imm != 0) {
+            emit_u8(0x81); emit_u8(0xc7); emit_u32((uint32_t)d->imm);  // add edi, imm32
+        }
+        if (d->id == INST_LB)       emit_call((void*)jit_lb);
+        else if (d->id == INST_LH)  emit_call((void*)jit_lh);
+        else if (d->id == INST_LW)  emit_call((void*)jit_lw);
+        else if (d->id == INST_LBU) emit_call((void*)jit_lbu);
+        else                        emit_call((void*)jit_lhu);
+        // 访问出错时load不执行，由解释器产生精确的异常
+        emit_u8(0x48); emit_u8(0x0f); emit_u8(0xba);
+        emit_u8(0xe0); emit_u8(0x20);               // bt rax, 32
+        loc = emit_jcc32(CC_AE);
+        emit_exit(pc,retired - 1);
+        patch32(loc);
+        emit_st(RAX,d->rd);
+        return 1;
+    // STORE
+    case INST_SB: case INST_SH: case INST_SW:
+        emit_ld(RDI,d->rs1);
+        if (d->imm != 0) {
+            emit_u8(0x81); emit_u8(0xc7); emit_u32((uint32_t)d->imm);
+        }
+        emit_ld(RSI,d->rs2);
+        if (d->id == INST_SB)       emit_call((void*)jit_sb);
+        else if (d->id == INST_SH)  emit_call((void*)jit_sh);
+        else                        emit_call((void*)jit_sw);
+        emit_u8(0x85); emit_u8(0xc0);               // test eax, eax
+        loc = emit_jcc32(CC_E);
+        // 访问出错时store不执行，由解释器产生精确的异常
+        emit_u8(0x83); emit_u8(0xf8); emit_u8(JIT_ST_FAULT); // cmp eax, JIT_ST_FAULT
+        fault = emit_jcc32(CC_E);
+        // 写到了已经翻译的代码，当前的本地代码已经失效，立即返回
+        emit_exit(pc + 4,retired);
+        patch32(fault);
+        emit_exit(pc,retired - 1);
+        patch32(loc);
+        return 1;
+    // BRANCH
+    case INST_BEQ: case INST_BNE: case INST_BLT:
+    case INST_BGE: case INST_BLTU: case INST_BGEU:
+        target = pc + (uint32_t)d->imm;
+        // 不对齐的跳转地址由解释器产生异常
+        if (misaligned(target))
+            return 0;
+        if (d->id == INST_BEQ)       cc = CC_E;
+        else if (d->id == INST_BNE)  cc = CC_NE;
+        else if (d->id == INST_BLT)  cc = CC_L;
+        else if (d->id == INST_BGE)  cc = CC_GE;
+        else if (d->id == INST_BLTU) cc = CC_B;
+        else                         cc = CC_AE;
+        emit_ld(RAX,d->rs1);
+        emit_ld(RCX,d->rs2);
+        emit_u8(0x39); emit_u8(0xc8);               // cmp eax, ecx
+        if (trace_next != 0) {
+            // 沿路径的方向继续执行，另一个方向是旁路出口
+            if (target == trace_next)
+                loc = emit_jcc32(cc);
+            else
+                loc = emit_jcc32(cc ^ 1);
+            emit_exit(target == trace_next ? pc + 4 : target,retired | JIT_RET_XFER);
+            patch32(loc);
+            return 1;
+        }
+        loc = emit_jcc32(cc);
+        emit_exit(pc + 4,retired | JIT_RET_XFER);
+        patch32(loc);
+        emit_exit(target,retired | JIT_RET_XFER);
+        return 2;
+    // JUMP
+    case INST_JAL:
+        target = pc + (uint32_t)d->imm;
+        if (misaligned(target))
+            return 0;
+        emit_set_imm(d->rd,pc + 4);
+        if (trace_next != 0)
+            return 1;
+        emit_exit(target,retired | JIT_RET_XFER);
+        return 2;
+    case INST_JALR:
+        emit_ld(RAX,d->rs1);
+        if (d->imm != 0)
+            emit_alu_ri(0x05,(uint32_t)d->imm);     // add eax, imm32
+        emit_u8(0x83); emit_u8(0xe0); emit_u8(0xfe);// and eax, -2
+        if (IALIGN == 32) {
+            emit_u8(0xa8); emit_u8(0x02);           // test al, 2
+            loc = emit_jcc32(CC_E);
+            // 不对齐的跳转地址，jalr不执行，由解释器产生异常
+            emit_exit(pc,retired - 1);
+            patch32(loc);
+        }
+        emit_set_imm(d->rd,pc + 4);
+        emit_exit_eax(retired | JIT_RET_XFER);
+        return 2;
+    default:
+        // SYSTEM，fence.i和非法指令
+        return 0;
+    }
+}
+
+// ----------------------------------------------
+// 优化层的分析
+// ----------------------------------------------
+// 没有副作用，结果只写入rd的指令
+static int is_pure(const DecInst *d){
+    switch (d->id)
+    {
+    case INST_ADD: case INST_SUB: case INST_SLL: case INST_SLT: case INST_SLTU:
+    case INST_XOR: case INST_SRL: case INST_SRA: case INST_OR:  case INST_AND:
+    case INST_MUL: case INST_MULH: case INST_MULHSU: case INST_MULHU:
+    case INST_ADDI: case INST_SLTI: case INST_SLTIU: case INST_XORI: case INST_ORI:
+    case INST_ANDI: case INST_SLLI: case INST_SRLI: case INST_SRAI:
+    case INST_LUI: case INST_AUIPC:
+        return 1;
+    case INST_DIV: case INST_DIVU: case INST_REM: case INST_REMU:
+        // rd为0时，特殊情况下会写入x[0]
+        return d->rd != 0;
+    default:
+        return 0;
+    }
+}
+
+// 写rd的指令
+static int writes_rd(const DecInst *d){
+    switch (d->id)
+    {
+    case INST_LB: case INST_LH: case INST_LW: case INST_LBU: case INST_LHU:
+    case INST_JAL: case INST_JALR:
+        return 1;
+    default:
+        return is_pure(d);
+    }
+}
+
+// 可能从中间返回的指令，返回时所有寄存器都必须是最新的
+// 除了纯计算之外都按照出口处理，load访问出错时也会从中间返回
+static int may_exit(const DecInst *d){
+    switch (d->id)
+    {
+    case INST_NOP: case INST_WFI: case INST_FENCE: case INST_FENCE_TSO:
+    case INST_PAUSE:
+        return 0;
+    default:
+        return !is_pure(d);
+    }
+}
+
+// 从后向前做活跃分析，标记结果在被读取之前就被覆盖的指令
+static void find_dead(const JitSrc *src, uint8_t *dead){
+    uint8_t live[32];
+    memset(live, 1, sizeof(live));
+    for (int i = (int)src->inst_num - 1; i >= 0; i--)
+    {
+        const DecInst *d = &(src->dec[i]);
+        dead[i] = 0;
+        if (is_pure(d) && d->rd != 0 && !live[d->rd]) {
+            dead[i] = 1;
+            continue;
+        }
+        if (writes_rd(d))
+            live[d->rd] = 0;
+        live[d->rs1] = 1;
+        live[d->rs2] = 1;
+        // 出口可能在指令执行之前（例如不对齐的jalr），之前写的寄存器都是活跃的
+        if (may_exit(d))
+            memset(live, 1, sizeof(live));
+    }
+}
+
+// 按使用次数为guest寄存器分配host寄存器
+static void alloc_host_regs(const JitSrc *src){
+    uint32_t use[32] = {0};
+    for (uint32_t i = 0; i < src->inst_num; i++)
+    {
+        const DecInst *d = &(src->dec[i]);
+        use[d->rd]  += 1;
+        use[d->rs1] += 1;
+        use[d->rs2] += 1;
+    }
+    use[0] = 0;
+    for (uint32_t k = 0; k < JIT_ALLOC_REGS; k++)
+    {
+        uint8_t best = 0;
+        for (uint8_t r = 1; r < 32; r++)
+        {
+            if (jc.host[r] < 0 && use[r] > use[best])
+                best = r;
+        }
+        if (best == 0 || use[best] < 3)
+            break;
+        jc.host[best] = (int8_t)alloc_regs[k];
+        jc.host_num += 1;
+        jc.host_reg += 1;
+    }
+}
+
+static uint64_t time_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void jit_src_init(JitSrc *src, Block *blk){
+    uint32_t k = 0; // superblock中当前基本块的位置
+    src->pc = (uint32_t)blk->pc;
+    src->inst_num = blk->inst_num;
+    for (uint32_t i = 0; i < blk->inst_num; i++)
+    {
+        src->dec[i] = blk->op[i].dec;
+        src->trace_next[i] = 0;
+        if (blk->trace != NULL && k + 1 < blk->trace->blk_num && i + 1 == blk->trace->off[k + 1]) {
+            src->trace_next[i] = (uint32_t)(blk->trace->path[k + 1]->pc);
+            k += 1;
+        }
+    }
+}
+
+// 按照tier将src编译到buf中，buf至少需要 inst_num * JIT_INST_CODE_MAX + 256 byte
+// 返回生成的代码长度，生成的代码与位置无关，可以复制到代码缓存中执行
+// 第一条指令无法编译时返回0
+static uint32_t jit_emit(const JitSrc *src, uint8_t tier, uint8_t *buf){
+    uint8_t dead[TRACE_MAX_INST];
+    uint32_t pc = src->pc;
+    uint32_t i;
+    int res = 0;
+
+    memset(&jc, 0, sizeof(JitCtx));
+    memset(jc.host, -1, sizeof(jc.host));
+    jc.tier = tier;
+    memset(dead, 0, sizeof(dead));
+    if (tier == JIT_TIER_OPT) {
+        alloc_host_regs(src);
+        find_dead(src,dead);
+        // 块内没有会写x[0]的除法时，x0按常量0处理，li/mv等可以在编译时计算
+        jc.is_const[0] = 1;
+        for (i = 0; i < src->inst_num; i++)
+        {
+            const DecInst *d = &(src->dec[i]);
+            if (d->rd == 0 && (d->id == INST_DIV || d->id == INST_DIVU ||
+                               d->id == INST_REM || d->id == INST_REMU))
+                jc.is_const[0] = 0;
+        }
+    }
+
+    cp = buf;
+    emit_prologue();
+    for (i = 0; i < src->inst_num; i++)
+    {
+        if (dead[i])
+            jc.dead_write += 1;
+        else {
+            res = emit_inst(&(src->dec[i]),pc,i + 1,src->trace_next[i]);
+            if (res != 1)
+                break;
+        }
+        pc = src->trace_next[i] ? src->trace_next[i] : pc + 4;
+    }
+    if (res == 2)
+        i += 1;
+    else
+        // 基本块因为长度结束，或者遇到了无法编译的指令
+        emit_exit(pc,i);
+
+    jc.inst = i;
+    return (i == 0) ? 0 : (uint32_t)(cp - buf);
+}
+
+// 代码缓存中是否还有size byte的空间
+// 基本块缓存被清空后，之前生成的代码都不会再被使用
+static int code_reserve(uint64_t size){
+    if (code_base == NULL)
+        return 0;
+    if (blk_cache_flush_gen() != code_gen) {
+        code_gen  = blk_cache_flush_gen();
+        code_used = 0;
+        code_full = 0;
+    }
+    if (code_used + size > JIT_CODE_SIZE) {
+        if (!code_full)
+            jit_stat.full += 1;
+        code_full = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static void jit_account(uint8_t tier, const JitCtx *ctx){
+    jit_stat.compile[tier] += 1;
+    jit_stat.inst[tier] += ctx->inst;
+    jit_stat.const_fold += ctx->const_fold;
+    jit_stat.dead_write += ctx->dead_write;
+    jit_stat.host_reg += ctx->host_reg;
+    jit_stat.code_size = code_used;
+}
+
+// 在CPU线程中按照tier编译基本块，返回本地代码的入口
+// 基本块的第一条指令无法编译或者代码缓存用完时返回NULL
+static void* jit_compile(Block *blk, uint8_t tier){
+    if (!code_reserve((uint64_t)blk->inst_num * JIT_INST_CODE_MAX + 256))
+        return NULL;
+
+    JitSrc src;
+    jit_src_init(&src,blk);
+    uint8_t *entry = code_base + code_used;
+    uint32_t size = jit_emit(&src,tier,entry);
+    if (size == 0)
+        return NULL;
+
+    code_used += size;
+    jit_account(tier,&jc);
+    return entry;
+}
+
+// ----------------------------------------------
+// 后台编译
+// ----------------------------------------------
+// CPU线程把需要编译的基本块复制到请求中，放入todo队列，后台线程编译后放入done队列
+// CPU线程在block_execute()的入口取出结果，基本块缓存没有被清空时复制到代码缓存并安装
+// 代码缓存和基本块只由CPU线程修改，安装之前基本块继续由解释器或者之前的层执行
+typedef struct jit_req_t
+{
+    Block   *blk;       // 编译完成后安装到的基本块
+    Block   *head;      // blk是superblock时为入口基本块，否则为NULL
+    uint64_t gen;       // 提交时的基本块缓存清空的版本，不一致时丢弃结果
+    uint8_t  tier;
+    uint8_t *code;      // 后台线程生成的代码，NULL表示无法编译
+    uint32_t size;
+    uint64_t ns;        // 编译花费的时间
+    JitCtx   ctx;       // 编译的统计
+    JitSrc   src;
+} JitReq;
+
+// 有界的多生产者多消费者无锁队列
+typedef struct jit_queue_cell_t
+{
+    _Atomic uint64_t seq;
+    JitReq *req;
+} JitQueueCell;
+
+typedef struct jit_queue_t
+{
+    _Atomic uint64_t head;  // 下一个写入的位置
+    _Atomic uint64_t tail;  // 下一个读取的位置
+    JitQueueCell cell[JIT_QUEUE_SIZE];
+} JitQueue;
+
+static JitQueue todo_q;
+static JitQueue done_q;
+static uint32_t req_num;    // 已经提交还没有安装的请求数，只由CPU线程访问
+static uint32_t worker_num;
+static pthread_t worker[JIT_MAX_THREADS];
+static atomic_int worker_stop;
+static sem_t todo_sem;      // todo队列中的请求数，空闲的后台线程在这里阻塞
+
+static void queue_init(JitQueue *q){
+    for (uint64_t i = 0; i < JIT_QUEUE_SIZE; i++)
+        atomic_store_explicit(&(q->cell[i].seq),i,memory_order_relaxed);
+    atomic_store(&(q->head),0);
+    atomic_store(&(q->tail),0);
+}
+
+// 队列已满时返回0
+static int queue_push(JitQueue *q, JitReq *req){
+    uint64_t pos = atomic_load_explicit(&(q->head),memory_order_relaxed);
+    JitQueueCell *c;
+    while (1)
+    {
+        c = &(q->cell[pos & (JIT_QUEUE_SIZE - 1)]);
+        uint64_t seq = atomic_load_explicit(&(c->seq),memory_order_acquire);
+        int64_t dif = (int64_t)seq - (int64_t)pos;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&(q->head),&pos,pos + 1,
+                                                      memory_order_relaxed,memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+            return 0;
+        else
+            pos = atomic_load_explicit(&(q->head),memory_order_relaxed);
+    }
+    c->req = req;
+    atomic_store_explicit(&(c->seq),pos + 1,memory_order_release);
+    return 1;
+}
+
+// 队列为空时返回NULL
+static JitReq* queue_pop(JitQueue *q){
+    uint64_t pos = atomic_load_explicit(&(q->tail),memory_order_relaxed);
+    JitQueueCell *c;
+    while (1)
+    {
+        c = &(q->cell[pos & (JIT_QUEUE_SIZE - 1)]);
+        uint64_t seq = atomic_load_explicit(&(c->seq),memory_order_acquire);
+        int64_t dif = (int64_t)seq - (int64_t)(pos + 1);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&(q->tail),&pos,pos + 1,
+                                                      memory_order_relaxed,memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+            return NULL;
+        else
+            pos = atomic_load_explicit(&(q->tail),memory_order_relaxed);
+    }
+    JitReq *req = c->req;
+    atomic_store_explicit(&(c->seq),pos + JIT_QUEUE_SIZE,memory_order_release);
+    return req;
+}
+
+static void* jit_worker(void *arg){
+    (void)arg;
+    uint8_t *buf = (uint8_t*)malloc(TRACE_MAX_INST * JIT_INST_CODE_MAX + 256);
+    while (1)
+    {
+        // jit_submit()和jit_free()每次post一次
+        if (sem_wait(&todo_sem) != 0)
+            continue;
+        if (atomic_load_explicit(&worker_stop,memory_order_relaxed))
+            break;
+        JitReq *req = queue_pop(&todo_q);
+        if (req == NULL)
+            continue;
+        uint64_t start = time_ns();
+        // 内存不足时按无法编译处理
+        req->size = (buf != NULL) ? jit_emit(&(req->src),req->tier,buf) : 0;
+        if (req->size != 0) {
+            req->code = (uint8_t*)malloc(req->size);
+            if (req->code != NULL)
+                memcpy(req->code,buf,req->size);
+            else
+                req->size = 0;
+        }
+        req->ctx = jc;
+        req->ns = time_ns() - start;
+        // 提交的请求数不超过队列容量，done队列不会满
+        while (!queue_push(&done_q,req))
+            sched_yield();
+    }
+    free(buf);
+    return NULL;
+}
+
+// 提交blk的编译请求，队列已满时返回0
+static int jit_submit(Block *blk, Block *head, uint8_t tier){
+    if (req_num >= JIT_QUEUE_SIZE)
+        return 0;
+    JitReq *req = (JitReq*)malloc(sizeof(JitReq));
+    if (req == NULL)
+        return 0;
+    req->blk  = blk;
+    req->head = head;
+    req->gen  = blk_cache_flush_gen();
+    req->tier = tier;
+    req->code = NULL;
+    req->size = 0;
+    jit_src_init(&(req->src),blk);
+    if (!queue_push(&todo_q,req)) {
+        free(req);
+        return 0;
+    }
+    sem_post(&todo_sem);
+    req_num += 1;
+    blk->pending = 1;
+    jit_stat.async += 1;
+    return 1;
+}
+
+static void jit_install(JitReq *req){
+    Block *blk = req->blk;
+    req_num -= 1;
+    // 基本块缓存已经被清空，或者blk的代码已经被改写
+    if (req->gen != blk_cache_flush_gen() || blk_is_dead(blk) ||
+        (req->head != NULL && blk_is_dead(req->head))) {
+        jit_stat.discard += 1;
+        return;
+    }
+    blk->pending = 0;
+    jit_stat.compile_ns[req->tier] += req->ns;
+    if (req->code != NULL && code_reserve(req->size)) {
+        uint8_t *entry = code_base + code_used;
+        memcpy(entry,req->code,req->size);
+        code_used += req->size;
+        jit_account(req->tier,&(req->ctx));
+        blk->native = entry;
+        blk->tier = req->tier;
+        if (req->head != NULL) {
+            req->head->super = blk;
+            jit_stat.trace += 1;
+        }
+    }
+    else if (req->head == NULL) {
+        // 无法编译的基本块留在当前层
+        if (req->code == NULL)
+            jit_stat.fail += 1;
+        blk->tier = JIT_TIER_OPT;
+    }
+}
+
+void jit_drain()
+{
+    JitReq *req;
+    while ((req = queue_pop(&done_q)) != NULL)
+    {
+        jit_install(req);
+        free(req->code);
+        free(req);
+    }
+}
+
+int jit_init(uint32_t hot, uint32_t opt_hot, uint32_t threads)
+{
+    code_base = (uint8_t*)mmap(NULL,JIT_CODE_SIZE,PROT_READ | PROT_WRITE | PROT_EXEC,
+                               MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+    if (code_base == MAP_FAILED) {
+        code_base = NULL;
+        return 1;
+    }
+    code_used = 0;
+    code_gen  = blk_cache_flush_gen();
+    code_full = 0;
+    memset(&jit_stat, 0, sizeof(JitStat));
+    // 优化层的阈值不能小于baseline层
+    jit_tier_hot[JIT_TIER_INTERP] = hot;
+    jit_tier_hot[JIT_TIER_BASE]   = (opt_hot > hot) ? opt_hot : hot;
+    jit_tier_hot[JIT_TIER_OPT]    = UINT32_MAX;
+
+    // 启动后台编译线程，创建失败时使用已经创建的线程，没有线程时在CPU线程中编译
+    queue_init(&todo_q);
+    queue_init(&done_q);
+    req_num = 0;
+    worker_num = 0;
+    atomic_store(&worker_stop,0);
+    if (threads > JIT_MAX_THREADS)
+        threads = JIT_MAX_THREADS;
+    if (threads > 0 && sem_init(&todo_sem,0,0) != 0)
+        threads = 0;
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        if (pthread_create(&worker[worker_num],NULL,jit_worker,NULL) != 0)
+            break;
+        worker_num += 1;
+    }
+    jit_stat.thread = worker_num;
+    return 0;
+}
+
+void jit_free()
+{
+    atomic_store(&worker_stop,1);
+    for (uint32_t i = 0; i < worker_num; i++)
+        sem_post(&todo_sem);
+    for (uint32_t i = 0; i < worker_num; i++)
+        pthread_join(worker[i],NULL);
+    if (worker_num > 0)
+        sem_destroy(&todo_sem);
+    worker_num = 0;
+    JitReq *req;
+    while ((req = queue_pop(&todo_q)) != NULL)
+        free(req);
+    while ((req = queue_pop(&done_q)) != NULL)
+    {
+        free(req->code);
+        free(req);
+    }
+    if (code_base != NULL)
+        munmap(code_base,JIT_CODE_SIZE);
+    code_base = NULL;
+}
+
+// 由后台线程编译，提交失败时返回0，由CPU线程编译
+static int jit_tier_up_async(Block *blk, uint8_t tier){
+    // 进入优化层时，同时沿着主要路径建立superblock
+    if (tier == JIT_TIER_OPT && blk->trace == NULL) {
+        Block *sb = blk_cache_trace(blk);
+        if (sb != NULL) {
+            sb->tier = JIT_TIER_OPT;
+            jit_submit(sb,blk,tier);
+        }
+    }
+    if (!jit_submit(blk,NULL,tier))
+        return 0;
+    // 预测执行：已经链接的后继很可能也会变热，提前编译
+    if (tier == JIT_TIER_BASE) {
+        for (uint32_t s = 0; s < 2; s++)
+        {
+            Block *nb = blk->next[s];
+            if (nb != NULL && !blk_is_dead(nb) && nb->tier == JIT_TIER_INTERP && !nb->pending &&
+                jit_submit(nb,NULL,JIT_TIER_BASE)) {
+                nb->exec_cnt = 0;
+                jit_stat.spec += 1;
+            }
+        }
+    }
+    return 1;
+}
+
+void jit_tier_up(Block *blk)
+{
+    uint8_t tier = blk->tier + 1;
+    blk->exec_cnt = 0;
+    if (tier >= JIT_TIER_NUM || blk->pending)
+        return;
+    if (worker_num > 0 && jit_tier_up_async(blk,tier))
+        return;
+
+    uint64_t start = time_ns();
+    // 进入优化层时，同时沿着主要路径建立superblock
+    if (tier == JIT_TIER_OPT && blk->trace == NULL) {
+        Block *sb = blk_cache_trace(blk);
+        if (sb != NULL) {
+            sb->native = jit_compile(sb,tier);
+            sb->tier = JIT_TIER_OPT;
+            if (sb->native != NULL) {
+                blk->super = sb;
+                jit_stat.trace += 1;
+            }
+        }
+    }
+    void *native = jit_compile(blk,tier);
+    jit_stat.compile_ns[tier] += time_ns() - start;
+
+    if (native != NULL) {
+        blk->native = native;
+        blk->tier = tier;
+    }
+    else {
+        // 无法编译的基本块留在当前层
+        if (!code_full)
+            jit_stat.fail += 1;
+        blk->tier = JIT_TIER_OPT;
+    }
+}
+
+uint8_t jit_code_full()
+{
+    return code_full;
+}
+
+#else // JIT_SUPPORT
+
+int jit_init(uint32_t hot, uint32_t opt_hot, uint32_t threads)
+{
+    return 1;
+}
+
+void jit_drain()
+{
+}
+
+void jit_free()
+{
+}
+
+void jit_tier_up(Block *blk)
+{
+    blk->exec_cnt = 0;
+}
+
+uint8_t jit_code_full()
+{
+    return 0;
+}
+
+#endif // JIT_SUPPORT
+
+JitStat* get_jit_stat()
+{
+    return &jit_stat;
+}
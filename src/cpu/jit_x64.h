@@ -0,0 +1,135 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// x86-64 JIT
+// 分层执行：基本块先由解释器执行，执行次数超过JIT_HOT后由baseline层编译，
+// 超过JIT_OPT_HOT后再由优化层重新编译，生成的代码放在mmap申请的可执行内存中
+// 进入优化层时，沿着分支的主要方向把后继基本块连接成superblock一起编译，偏离路径时从旁路出口返回
+// 通用寄存器x[]的基地址通过参数传入，baseline层生成的代码直接读写x[]
+// 优化层将块内常用的寄存器放在host寄存器中，传播lui/addi等产生的常量，并删除被覆盖的写
+// load/store调用辅助函数，经过软件TLB直接访问DRAM，其他地址空间交给read_data()/write_data()
+// SYSTEM指令和非法指令不编译，本地代码执行到这些指令之前返回，剩余的指令由解释器执行
+// 使能后台编译线程时，编译请求通过无锁队列交给后台线程，CPU线程在编译完成前继续执行之前的层
+
+#ifndef __JIT_X64_H__
+    #define __JIT_X64_H__
+
+#include <stdint.h>
+#include "cpu_config.h"
+#include "block_cache.h"
+
+#if defined(__x86_64__) && !defined(RV64)
+    #define JIT_SUPPORT
+#endif
+
+#define JIT_HOT         16                  // 基本块执行多少次后由baseline层编译
+#define JIT_OPT_HOT     2048                // 基本块执行多少次后由优化层重新编译
+#define JIT_CODE_SIZE   (16 * 1024 * 1024)  // 本地代码缓存的大小
+#define JIT_QUEUE_SIZE  1024                // 后台编译队列的容量，必须是2的幂
+#define JIT_MAX_THREADS 64                  // 后台编译线程的最大数量
+
+// 本地代码的返回值
+// next_pc: 下一条需要执行的指令地址
+// retired: 本地代码执行的指令数，小于基本块的指令数时，剩余的指令需要由解释器执行
+typedef struct jit_ret_t
+{
+    uint64_t next_pc;
+    uint64_t retired;
+} JitRet;
+
+typedef JitRet (*JitFunc)(MXLEN_T *x);
+
+// retired中的标记，表示本地代码在分支或者跳转处返回，next_pc为跳转的结果
+// 没有标记且retired小于指令数时，第retired条指令还没有执行
+#define JIT_RET_XFER    0x80000000
+
+// 执行层级，保存在Block.tier中
+typedef enum jit_tier_e
+{
+    JIT_TIER_INTERP = 0, // 由block_execute()解释执行
+    JIT_TIER_BASE   = 1, // baseline层，逐条翻译
+    JIT_TIER_OPT    = 2, // 优化层
+    JIT_TIER_NUM    = 3
+} JitTier;
+
+typedef struct jit_stat_t
+{
+    uint64_t compile[JIT_TIER_NUM];     // 各层编译的基本块数，即进入该层的次数
+    uint64_t inst[JIT_TIER_NUM];        // 各层编译的指令数
+    uint64_t compile_ns[JIT_TIER_NUM];  // 各层编译花费的时间
+    uint64_t fail;                      // 无法编译的次数
+    uint64_t const_fold;                // 优化层在编译时计算的指令数
+    uint64_t dead_write;                // 优化层删除的指令数
+    uint64_t host_reg;                  // 优化层分配的host寄存器数
+    uint64_t trace;                     // 编译的superblock数
+    uint64_t code_size;                 // 当前使用的代码缓存大小
+    uint64_t full;                      // 代码缓存用完的次数
+    uint64_t thread;                    // 后台编译线程数
+    uint64_t async;                     // 提交给后台线程的编译请求数
+    uint64_t spec;                      // 其中预测执行的后继基本块数
+    uint64_t discard;                   // 基本块缓存被清空后丢弃的编译结果数
+} JitStat;
+
+// 初始化JIT，申请代码缓存
+// hot: 进入baseline层的执行次数，opt_hot: 进入优化层的执行次数
+// threads: 后台编译线程数，为0时在CPU线程中编译
+// 成功返回0，不支持或者申请失败时返回1
+int  jit_init(uint32_t hot, uint32_t opt_hot, uint32_t threads);
+void jit_free();
+
+// 安装后台线程已经编译完成的代码，只能在CPU线程没有持有基本块时调用
+void jit_drain();
+
+// 各层之后进入下一层的执行次数，JIT没有初始化时不会进入下一层
+extern uint32_t jit_tier_hot[JIT_TIER_NUM];
+
+// 按照下一层编译基本块，更新blk->native和blk->tier
+// 编译失败时保留原来的代码，不再尝试编译
+// 使能后台编译线程时只提交请求，由jit_drain()更新
+void jit_tier_up(Block *blk);
+
+// 代码缓存已经用完，需要在安全的位置清空基本块缓存
+uint8_t jit_code_full();
+
+JitStat* get_jit_stat();
+
+// 本地代码使用的load/store辅助函数，JIT和AOT共用
+// 软件TLB命中时直接访问DRAM，其他情况交给read_data()/write_data()
+// load的结果在低32位，访问出错时返回JIT_LD_FAULT
+// store返回JIT_ST_INVAL表示写到了已经翻译的代码，有基本块已经失效
+// 访问出错时指令都不执行，本地代码返回到这条指令，由解释器产生异常
+#define JIT_LD_FAULT    ((uint64_t)1 << 32)
+#define JIT_ST_OK       0
+#define JIT_ST_INVAL    1
+#define JIT_ST_FAULT    2
+uint64_t jit_lb(uint32_t addr);
+uint64_t jit_lh(uint32_t addr);
+uint64_t jit_lw(uint32_t addr);
+uint64_t jit_lbu(uint32_t addr);
+uint64_t jit_lhu(uint32_t addr);
+int jit_sb(uint32_t addr, uint32_t data);
+int jit_sh(uint32_t addr, uint32_t data);
+int jit_sw(uint32_t addr, uint32_t data);
+
+#endif //__JIT_X64_H__
@@ -0,0 +1,213 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "lockstep.h"
+#include "back_end.h"
+#include "front_end.h"
+#include "sys_reg.h"
+#include "dec_cache.h"
+#include "block_cache.h"
+#include "../include/comm.h"
+#include "../include/color.h"
+
+// 参与比较的CSR
+static const struct {
+    uint32_t addr;
+    const char *name;
+} ls_csr[LOCKSTEP_CSR_NUM] = {
+    {0x300,"mstatus"},  {0x301,"misa"},     {0x304,"mie"},      {0x305,"mtvec"},
+    {0x306,"mcounteren"},{0x310,"mstatush"},{0x340,"mscratch"}, {0x341,"mepc"},
+    {0x342,"mcause"},   {0x343,"mtval"},    {0x344,"mip"},      {0xC02,"instret"},
+    {0xC82,"instreth"}
+};
+
+static int req_fd = -1;     // 当前进程 -> 参考进程：下一个比较点的指令数
+static int rsp_fd = -1;     // 参考进程 -> 当前进程：比较点上的状态
+static pid_t ref_pid = -1;
+static uint64_t check_cnt = 0;
+static uint64_t match_iid = 0; // 最后一次比较一致时的指令数
+
+static int fd_write(int fd, const void *buf, size_t len){
+    const uint8_t *p = (const uint8_t*)buf;
+    while (len > 0)
+    {
+        ssize_t n = write(fd,p,len);
+        if (n <= 0)
+            return 1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int fd_read(int fd, void *buf, size_t len){
+    uint8_t *p = (uint8_t*)buf;
+    while (len > 0)
+    {
+        ssize_t n = read(fd,p,len);
+        if (n <= 0)
+            return 1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int lockstep_fork()
+{
+    int req[2], rsp[2];
+    if (pipe(req) != 0)
+        return -1;
+    if (pipe(rsp) != 0) {
+        close(req[0]);
+        close(req[1]);
+        return -1;
+    }
+    // 缓冲区中还没有输出的内容不能被两个进程各输出一次
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(req[0]);
+        close(req[1]);
+        close(rsp[0]);
+        close(rsp[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(req[1]);
+        close(rsp[0]);
+        req_fd = req[0];
+        rsp_fd = rsp[1];
+        // 参考进程的输出与当前进程重复，不再打印
+        if (freopen("/dev/null","w",stdout) == NULL)
+            fclose(stdout);
+        return 1;
+    }
+    close(req[0]);
+    close(rsp[1]);
+    req_fd = req[1];
+    rsp_fd = rsp[0];
+    ref_pid = pid;
+    // 参考进程意外退出时，由写入失败报告，而不是被SIGPIPE结束
+    signal(SIGPIPE,SIG_IGN);
+    return 0;
+}
+
+int lockstep_wait(uint64_t *target)
+{
+    return fd_read(req_fd,target,sizeof(uint64_t));
+}
+
+void lockstep_reply(const ArchState *st)
+{
+    fd_write(rsp_fd,st,sizeof(ArchState));
+}
+
+static void print_diff(const char *name, uint64_t dut, uint64_t ref){
+    if (dut != ref)
+        printf(L_RED "%-10s 0x%08lx 0x%08lx  <--" NONE "\n",name,dut,ref);
+    else
+        printf("%-10s 0x%08lx 0x%08lx\n",name,dut,ref);
+}
+
+int lockstep_check(const ArchState *st)
+{
+    ArchState ref;
+    check_cnt += 1;
+    if (fd_write(req_fd,&(st->iid),sizeof(uint64_t)) || fd_read(rsp_fd,&ref,sizeof(ArchState))) {
+        printf("**********" L_RED " LOCKSTEP ERROR " NONE "**********\n");
+        printf("Reference process is not responding at instruction %lu\n",st->iid);
+        return 1;
+    }
+    if (ref.iid == st->iid && ref.pc == st->pc && ref.mode == st->mode && ref.exit == st->exit &&
+        memcmp(ref.x,st->x,sizeof(ref.x)) == 0 && memcmp(ref.csr,st->csr,sizeof(ref.csr)) == 0) {
+        match_iid = st->iid;
+        return 0;
+    }
+
+    char name[8];
+    printf("**********" L_RED " LOCKSTEP DIVERGENCE " NONE "**********\n");
+    printf("Check %lu, diverged after instruction %lu and before instruction %lu\n",check_cnt,match_iid,st->iid);
+    printf("%-10s %-10s %-10s\n","","engine","reference");
+    print_diff("iid",st->iid,ref.iid);
+    print_diff("pc",st->pc,ref.pc);
+    print_diff("mode",st->mode,ref.mode);
+    print_diff("exit",st->exit,ref.exit);
+    for (int i = 0; i < 32; i++)
+    {
+        snprintf(name,sizeof(name),"x%d",i);
+        print_diff(name,st->x[i],ref.x[i]);
+    }
+    for (int i = 0; i < LOCKSTEP_CSR_NUM; i++)
+        print_diff(ls_csr[i].name,st->csr[i],ref.csr[i]);
+    printf("*******************************\n");
+    return 1;
+}
+
+void lockstep_end()
+{
+    if (ref_pid < 0)
+        return;
+    // 关闭管道后参考进程读到EOF，自行退出
+    close(req_fd);
+    close(rsp_fd);
+    waitpid(ref_pid,NULL,0);
+    ref_pid = -1;
+    printf("Lockstep Check: %lu\n",check_cnt);
+}
+
+void arch_state_read(ArchState *st, uint64_t iid, uint64_t pc, CPUMode mode, uint8_t exit)
+{
+    memset(st,0,sizeof(ArchState));
+    st->iid = iid;
+    st->pc = pc;
+    st->mode = mode;
+    st->exit = exit;
+    read_xregs(st->x);
+    for (int i = 0; i < LOCKSTEP_CSR_NUM; i++)
+        csr_read(ls_csr[i].addr,&(st->csr[i]));
+}
+
+uint32_t lockstep_blk_len(uint64_t pc)
+{
+    uint32_t inst_num = 0;
+    while (inst_num < BLK_MAX_INST)
+    {
+        DecInst *d = fetch_dec_inst(pc);
+        if (d == NULL)
+            break;
+        inst_num += 1;
+        pc += 4;
+        if (is_blk_end(d->id) || MOD(pc,DEC_PAGE_SIZE) == 0)
+            break;
+    }
+    return inst_num ? inst_num : 1;
+}
@@ -0,0 +1,76 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// lockstep差分执行
+// 在自测模式下fork出一个参考进程，两个进程各自持有一份guest状态的拷贝（写时复制）
+// 参考进程只使用interp引擎逐条执行，当前进程使用用户选择的执行引擎
+// 当前进程每执行到一个比较点，就让参考进程执行到相同的指令数，然后比较两边的PC，通用寄存器和CSR
+// 比较点可以是每N条指令，也可以是每个基本块
+// 第一次出现差异时打印两边的完整状态，并停止执行
+
+#ifndef __LOCKSTEP_H__
+    #define __LOCKSTEP_H__
+
+#include <stdint.h>
+#include "cpu_config.h"
+#include "cpu_glb.h"
+
+#define LOCKSTEP_BLOCK  UINT64_MAX  // 以基本块为间隔进行比较
+#define LOCKSTEP_CSR_NUM 13         // 参与比较的CSR数量，cycle和time与执行快慢有关，不参与比较
+
+// 比较点上的体系结构状态
+typedef struct arch_state_t
+{
+    uint64_t iid;                   // 已经执行的指令数
+    uint64_t pc;                    // 下一条要执行的指令
+    MXLEN_T  x[32];                 // 通用寄存器
+    MXLEN_T  csr[LOCKSTEP_CSR_NUM]; // CSR
+    uint8_t  mode;                  // 特权模式
+    uint8_t  exit;                  // 自测程序的退出状态
+} ArchState;
+
+// 创建参考进程
+// 当前进程返回0，参考进程返回1，失败时返回-1
+int lockstep_fork();
+
+// 参考进程：等待下一个比较点的指令数，当前进程结束比较时返回非0
+int lockstep_wait(uint64_t *target);
+
+// 参考进程：回复执行到比较点时的状态
+void lockstep_reply(const ArchState *st);
+
+// 当前进程：让参考进程执行到st->iid，然后与st比较
+// 一致时返回0，出现差异时打印两边的状态并返回非0
+int lockstep_check(const ArchState *st);
+
+// 当前进程：结束参考进程，并打印比较的次数
+void lockstep_end();
+
+// 读取当前的通用寄存器和CSR
+void arch_state_read(ArchState *st, uint64_t iid, uint64_t pc, CPUMode mode, uint8_t exit);
+
+// pc开始的基本块的指令数，切分规则与block_cache一致，无法取指时返回1
+uint32_t lockstep_blk_len(uint64_t pc);
+
+#endif //__LOCKSTEP_H__
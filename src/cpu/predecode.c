@@ -0,0 +1,111 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include "predecode.h"
+
+// 译码表由 misc/python/decode.py 根据 misc/rv32_dec.toml 生成
+// 使用CMake构建时生成在构建目录中，由DEC_TABLE_FILE指定，否则使用随源码提交的文件
+#ifdef DEC_TABLE_FILE
+    #include DEC_TABLE_FILE
+#else
+    #include "dec_table.h"
+#endif
+
+// 在匹配组中按顺序比较，都不匹配时使用组内的默认指令
+// SYSTEM和MISC_MEM等少数指令才会走到这里，不内联以免影响常见指令的译码
+static __attribute__((noinline)) uint8_t dec_match(uint8_t grp_id, uint32_t inst){
+    const DecMatchGrp *grp = &dec_match_grp[grp_id];
+    const DecMatch *m = &dec_match_tbl[grp->first];
+    for (uint8_t i = 0; i < grp->num; i++, m++)
+    {
+        if ((inst & m->mask) == m->match)
+            return m->id;
+    }
+    return grp->dflt;
+}
+
+void predecode(uint32_t inst, DecInst* dec)
+{
+    uint8_t func7 = (inst & 0b11111110000000000000000000000000) >> 25;
+    uint8_t func3 = (inst & 0b00000000000000000111000000000000) >> 12;
+    uint8_t rd    = (inst & 0b00000000000000000000111110000000) >> 7;
+    uint8_t rs1   = (inst & 0b00000000000011111000000000000000) >> 15;
+    uint8_t rs2   = (inst & 0b00000001111100000000000000000000) >> 20;
+
+    // 第一级：opcode[6:2]，低两位不是0b11的都不是32bit指令
+    uint8_t row = ((inst & 0b11) == 0b11) ? dec_op_tbl[(inst >> 2) & 0x1F] : 0;
+    // 第二级：func3和func7的分类
+    uint8_t id = dec_sub_tbl[row][func3 * DEC_F7_NUM + dec_f7_tbl[func7]];
+    // 还需要比较rd，rs1和imm等字段的少数指令
+    if (id & DEC_MATCH)
+        id = dec_match(id & ~DEC_MATCH,inst);
+
+    dec->id   = id;
+    dec->hid  = id;
+    dec->rd   = rd;
+    dec->rs1  = rs1;
+    dec->rs2  = rs2;
+    dec->imm  = dec_imm(inst);
+    dec->inst = inst;
+}
+
+uint8_t fuse_pair(const DecInst* first, const DecInst* second)
+{
+    uint8_t rd = first->rd;
+    // 第一条指令的结果不写入时没有融合的意义
+    if (rd == 0)
+        return first->id;
+
+    switch (first->id)
+    {
+    case INST_LUI:
+        if (second->id == INST_ADDI && second->rd == rd && second->rs1 == rd)
+            return FUSE_LUI_ADDI;
+        break;
+    case INST_AUIPC:
+        if (second->id == INST_JALR && second->rs1 == rd)
+            return FUSE_AUIPC_JALR;
+        if (second->id == INST_LW && second->rs1 == rd)
+            return FUSE_AUIPC_LW;
+        break;
+    case INST_SLLI:
+        if (second->id == INST_SRLI && second->rd == rd && second->rs1 == rd)
+            return FUSE_SLLI_SRLI;
+        break;
+    case INST_SLT: case INST_SLTU: case INST_SLTI: case INST_SLTIU:
+        // 分支只比较比较结果和x0
+        if ((second->id == INST_BEQ || second->id == INST_BNE) &&
+            ((second->rs1 == rd && second->rs2 == 0) || (second->rs1 == 0 && second->rs2 == rd))) {
+            if (first->id == INST_SLT)        return FUSE_SLT_BR;
+            else if (first->id == INST_SLTU)  return FUSE_SLTU_BR;
+            else if (first->id == INST_SLTI)  return FUSE_SLTI_BR;
+            else                              return FUSE_SLTIU_BR;
+        }
+        break;
+    default:
+        break;
+    }
+    return first->id;
+}
@@ -0,0 +1,158 @@
+/*
+MIT License
+
+Copyright (c) 2023 jackkyyang
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// 预译码
+// 将32bit的指令一次性拆解成指令编号和操作数，结果可以被缓存并重复执行
+// 执行阶段只需要根据指令编号进行分发，不需要再次提取opcode/func3/func7和立即数
+
+#ifndef __PREDECODE_H__
+    #define __PREDECODE_H__
+
+#include <stdint.h>
+#include "cpu_config.h"
+
+// 指令编号
+typedef enum inst_id
+{
+    INST_NONE = 0,  // 空表项，表示还没有完成译码
+    INST_ILLEGAL,   // 非法指令
+    INST_NOP,       // 没有实现的SYSTEM指令，不产生任何效果
+    // OP_32
+    INST_ADD,
+    INST_SUB,
+    INST_SLL,
+    INST_SLT,
+    INST_SLTU,
+    INST_XOR,
+    INST_SRL,
+    INST_SRA,
+    INST_OR,
+    INST_AND,
+    // OP_32, M extension
+    INST_MUL,
+    INST_MULH,
+    INST_MULHSU,
+    INST_MULHU,
+    INST_DIV,
+    INST_DIVU,
+    INST_REM,
+    INST_REMU,
+    // OP_IMM
+    INST_ADDI,
+    INST_SLTI,
+    INST_SLTIU,
+    INST_XORI,
+    INST_ORI,
+    INST_ANDI,
+    INST_SLLI,
+    INST_SRLI,
+    INST_SRAI,
+    // BRANCH
+    INST_BEQ,
+    INST_BNE,
+    INST_BLT,
+    INST_BGE,
+    INST_BLTU,
+    INST_BGEU,
+    // JUMP
+    INST_JAL,
+    INST_JALR,
+    // LOAD
+    INST_LB,
+    INST_LH,
+    INST_LW,
+    INST_LBU,
+    INST_LHU,
+    // STORE
+    INST_SB,
+    INST_SH,
+    INST_SW,
+    // load imme
+    INST_LUI,
+    INST_AUIPC,
+    // SYSTEM
+    INST_ECALL,
+    INST_EBREAK,
+    INST_MRET,
+    INST_WFI,
+    INST_CSRRW,
+    INST_CSRRS,
+    INST_CSRRC,
+    INST_CSRRWI,
+    INST_CSRRSI,
+    INST_CSRRCI,
+    // MISC_MEM
+    INST_FENCE,
+    INST_FENCE_TSO,
+    INST_PAUSE,
+    INST_FENCE_I,
+
+    INST_NUM
+} InstID;
+
+// 融合指令编号
+// 预译码时识别出的常见指令对，由执行引擎作为一条融合的micro-op分发
+// 编号接在InstID之后，与InstID共用执行引擎的handler表
+typedef enum fuse_id
+{
+    FUSE_LUI_ADDI = INST_NUM,   // lui rd + addi rd, rd：加载32bit常量
+    FUSE_AUIPC_JALR,            // auipc rd + jalr rs1=rd：远跳转和调用
+    FUSE_AUIPC_LW,              // auipc rd + lw rs1=rd：PC相对的load
+    FUSE_SLLI_SRLI,             // slli rd + srli rd, rd：零扩展和位域提取
+    FUSE_SLT_BR,                // slt/sltu/slti/sltiu rd + beq/bne rd, x0：比较后分支
+    FUSE_SLTU_BR,
+    FUSE_SLTI_BR,
+    FUSE_SLTIU_BR,
+
+    HANDLER_NUM
+} FuseID;
+
+// 译码结果
+// 对于不同类型的指令，imm中保存的内容不同：
+//  I-type：     符号扩展后的imm[11:0]
+//  S/B/J-type： 拼接并符号扩展后的偏移量
+//  U-type：     inst[31:12] << 12
+//  shift imm：  shamt
+//  CSR：        符号扩展后的CSR地址，与原有的csr指令接口保持一致
+typedef struct dec_inst_t
+{
+    uint8_t  id;    // InstID
+    uint8_t  hid;   // 执行引擎分发使用的编号，与下一条指令融合时为FuseID，否则与id相同
+    uint8_t  rd;
+    uint8_t  rs1;
+    uint8_t  rs2;
+    int32_t  imm;
+    uint32_t inst;  // 原始指令，异常时写入mtval
+} DecInst;
+
+// 对一条32bit指令进行译码
+// inst: 指令内容
+// dec:  译码结果
+void predecode(uint32_t inst, DecInst* dec);
+
+// 判断相邻的两条指令能否融合
+// 能融合时返回FuseID，否则返回first->id
+uint8_t fuse_pair(const DecInst* first, const DecInst* second);
+
+#endif //__PREDECODE_H__
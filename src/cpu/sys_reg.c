@@ -635,6 +635,8 @@ int csr_read(uint32_t csr, MXLEN_T *rdptr){
 
     default:
         // 访问非法寄存器地址，返回1
+        // 读出的值固定为0，调用者没有检查返回值时也不会读到未初始化的值
+        *rdptr = 0;
         return 1;
     }
 
@@ -802,6 +804,10 @@ void raise_illegal_instruction(CPUMode curr_mode,MXLEN_T inst){
     trap2m(0,2,curr_mode);
     mtval = inst;
 }
+void raise_exception(CPUMode curr_mode,MXLEN_T e_code,MXLEN_T tval){
+    trap2m(0,e_code,curr_mode);
+    mtval = tval;
+}
 MXLEN_T int_mask_proc(MXLEN_T int_id,CPUMode curr_mode)
 {
     // 对应特权文档3.1.9章节中关于M模式中断的描述
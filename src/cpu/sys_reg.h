@@ -54,6 +54,8 @@ SOFTWARE.
     void trap2m(MXLEN_T interrupt,MXLEN_T e_code,CPUMode curr_mode);
     void mret_proc();
     void raise_illegal_instruction(CPUMode curr_mode,MXLEN_T inst);
+    // 以e_code trap到M模式，并将tval写入mtval
+    void raise_exception(CPUMode curr_mode,MXLEN_T e_code,MXLEN_T tval);
     MXLEN_T int_mask_proc(MXLEN_T int_id,CPUMode curr_mode);
 
     // Machine Interrupt Registers
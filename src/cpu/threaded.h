@@ -0,0 +1,111 @@
+
+// Threaded code 执行引擎
+// 每种指令对应一个handler，handler执行完成后通过computed goto直接跳转到下一条指令的handler，
+// 不再每条指令都返回到cpu_run()，也不再逐条清除flags、查询中断和遍历异常
+// handler的实现见engine_body.h
+// 本文件只能被back_end.c包含，需要使用其中的x[]，pc，next_pc等状态
+
+#include <stdint.h>
+#include "back_end.h"
+#include "execution.h"
+#include "front_end.h"
+#include "predecode.h"
+#include "dec_cache.h"
+#include "engine_ops.h"
+#include "hle.h"
+
+uint64_t threaded_execute(uint64_t start_pc, uint64_t budget)
+{
+    static const void *const handler[HANDLER_NUM] = { ENG_HANDLER_TABLE };
+
+    ExeStatus *e_st = get_exe_st_ptr();
+    CPUMode curr_mode = get_cpu_mode();
+    uint64_t retired = 0; // 已经退休的指令数
+    uint64_t counted = 0; // 已经计入instret的指令数
+    DecInst *d;
+    // 没有注册HLE入口时不查表，执行期间不会再注册
+    const int hle_on = hle_num != 0;
+
+    // 有中断需要处理时，交给instruction_execute()
+    if (int_mask_proc(get_int_val(),curr_mode) > 0)
+        return 0;
+
+    // HLE的入口返回执行循环，由hle_execute()完成调用
+    if (hle_on && hle_lookup(start_pc))
+        return 0;
+    pc = start_pc;
+    if ((d = fetch_dec_inst(pc)) == NULL)
+        return 0;
+    goto *handler[d->hid];
+
+// 退休当前指令，顺序执行下一条指令
+// 下一条指令在同一页且已经译码时，直接使用相邻的表项
+#define ENG_NEXT()                                                      \
+    do {                                                                \
+        retired += 1;                                                   \
+        if (retired == budget) {                                        \
+            e_st->curr_pc = pc;                                         \
+            pc += 4;                                                    \
+            goto eng_exit;                                              \
+        }                                                               \
+        pc += 4;                                                        \
+        if (MOD(pc,DEC_PAGE_SIZE) != 0 && d[1].id != INST_NONE)         \
+            d += 1;                                                     \
+        else if ((d = fetch_dec_inst(pc)) == NULL) {                    \
+            e_st->curr_pc = pc - 4;                                     \
+            goto eng_exit;                                              \
+        }                                                               \
+        goto *handler[d->hid];                                           \
+    } while (0)
+
+// 融合的第二条指令一定在同一页且已经译码
+#define ENG_FUSED()                                                     \
+    do {                                                                \
+        retired += 1;                                                   \
+        if (retired == budget) {                                        \
+            e_st->curr_pc = pc;                                         \
+            pc += 4;                                                    \
+            goto eng_exit;                                              \
+        }                                                               \
+        pc += 4;                                                        \
+        d += 1;                                                         \
+    } while (0)
+
+// 写操作只会使译码缓存中的表项失效，ENG_NEXT()会重新取指
+#define ENG_STORE() ENG_NEXT()
+
+// 退休当前指令，跳转到next_pc
+#define TC_JUMP()                                                       \
+    do {                                                                \
+        retired += 1;                                                   \
+        e_st->curr_pc = pc;                                             \
+        pc = next_pc;                                                   \
+        if (retired == budget || (hle_on && hle_lookup(pc)))            \
+            goto eng_exit;                                              \
+        if ((d = fetch_dec_inst(pc)) == NULL)                           \
+            goto eng_exit;                                              \
+        goto *handler[d->hid];                                           \
+    } while (0)
+
+#define ENG_BRANCH()                                                    \
+    do {                                                                \
+        if (e_st->exception)                                            \
+            goto eng_trap;                                              \
+        if (next_pc == pc + 4)                                          \
+            ENG_NEXT();                                                 \
+        else                                                            \
+            TC_JUMP();                                                  \
+    } while (0)
+
+// 没有基本块，跳转与分支的处理相同
+#define ENG_JUMP() ENG_BRANCH()
+
+#include "engine_body.h"
+
+#undef ENG_NEXT
+#undef ENG_STORE
+#undef ENG_BRANCH
+#undef ENG_JUMP
+#undef ENG_FUSED
+#undef TC_JUMP
+}
@@ -72,6 +72,16 @@ MXLEN_T get_int_val()
     return glb_int_id;
 }
 
+uint8_t int_maybe_pending()
+{
+    // 中断线由设备线程在加锁时写入，这里只做原子读，不保证读到最新值
+    // 读到旧值时，最多推迟到下一次查询才处理中断
+    uint8_t pending = effective_screen_int | effective_kbd_int;
+    pending |= __atomic_load_n(s_screen_int_ptr,__ATOMIC_RELAXED);
+    pending |= __atomic_load_n(s_kbd_int_ptr,__ATOMIC_RELAXED);
+    return pending;
+}
+
 void int_clr(MXLEN_T int_id)
 {
     if (int_id == SCREEN_INT_ID)
@@ -21,6 +21,11 @@ void int_init(pthread_mutex_t* screen_int_mutex, pthread_mutex_t* kbd_int_mutex,
 // > 0：存在中断，且返回中断的cause编号
 MXLEN_T get_int_val();
 
+// 不加锁，快速判断是否可能存在中断
+// 返回0时，调用get_int_val()的结果一定为0，且不会改变mip
+// 供执行引擎在基本块边界频繁查询使用
+uint8_t int_maybe_pending();
+
 void int_clr(MXLEN_T);
 
 MXLEN_T get_int_id();
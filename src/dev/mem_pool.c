@@ -24,8 +24,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "../include/comm.h"
 #include "mem_pool.h"
+#include "dev_config.h"
 
 #define ALIGN32_L1(addr) ((addr & (0xf0000000)) >> 28)
 #define ALIGN32_L2(addr) ((addr & (0x0ff80000)) >> 19)
@@ -52,6 +56,7 @@ static uint64_t l3_table_size; // 内存池大小，单位是ENTRY_SIZE
 typedef struct l3_entry_t
 {
     uint8_t valid; // 本级表的offset 为[18:12]
+    uint8_t code;  // 该页中有已经翻译的代码，写入时需要使翻译结果失效
     uint8_t *addr; // 每个表容纳的地址空间
 }L3Entry;
 
@@ -70,6 +75,18 @@ typedef struct l1_entry_t
 // 创建第一级表，常驻内存
 static L1Entry l1_table [L1_LEN];
 
+// MEM_POOL_FLAT和MEM_POOL_GUARD时整个DRAM的host地址，以及每一页的代码标记
+#define FLAT_PAGE_NUM (DRAM_SIZE / ENTRY_SIZE)
+static uint8_t *flat_base = NULL;
+static uint8_t *map_base = NULL;  // mmap返回的地址，MEM_POOL_GUARD时是整个保护区
+static uint64_t map_size;
+static uint8_t flat_code [FLAT_PAGE_NUM];
+static uint64_t flat_size;  // 释放之前已经分配的物理内存，单位KB
+
+static inline int in_flat(uint64_t addr){
+    return flat_base != NULL && addr >= DRAM_BASE && addr <= DRAM_END;
+}
+
 static L2Entry* create_l2_table(L1Entry* l1_table){
     // 创建并初始化L2 table
     L2Entry* l2_table = (L2Entry*)malloc(sizeof(L2Entry)*L2_LEN);
@@ -96,6 +113,7 @@ static L3Entry* create_l3_table(L2Entry* l2_table){
     for (uint32_t i = 0; i < L3_LEN; i++)
     {
         l3_table[i].valid = 0;
+        l3_table[i].code = 0;
         l3_table[i].addr = NULL;
     }
 
@@ -118,6 +136,9 @@ static uint8_t* add_new_mem(){
 
 uint8_t *mem_pool_lkup(uint64_t addr)
 {
+    if (in_flat(addr))
+        return flat_base + (addr - DRAM_BASE);
+
     uint32_t l1_addr = ALIGN32_L1(addr);
     uint32_t l2_addr = ALIGN32_L2(addr);
     uint32_t l3_addr = ALIGN32_L3(addr);
@@ -153,7 +174,61 @@ uint8_t *mem_pool_lkup(uint64_t addr)
 
 }
 
-void mem_pool_init()
+// 只查询不分配，页不存在时返回NULL
+static L3Entry *l3_entry_lkup(uint64_t addr){
+    uint32_t l1_addr = ALIGN32_L1(addr);
+    uint32_t l2_addr = ALIGN32_L2(addr);
+    uint32_t l3_addr = ALIGN32_L3(addr);
+
+    if (!l1_table[l1_addr].valid)
+        return NULL;
+    L2Entry *l2_table = l1_table[l1_addr].l2_table;
+    if (!l2_table[l2_addr].valid)
+        return NULL;
+    L3Entry *l3_entry = &(l2_table[l2_addr].l3_table[l3_addr]);
+    if (!l3_entry->valid)
+        return NULL;
+    return l3_entry;
+}
+
+void mem_pool_set_code(uint64_t addr, uint8_t code)
+{
+    if (in_flat(addr)) {
+        flat_code[(addr - DRAM_BASE) / ENTRY_SIZE] = code;
+        return;
+    }
+    L3Entry *l3_entry = l3_entry_lkup(addr);
+    if (l3_entry != NULL)
+        l3_entry->code = code;
+}
+
+uint8_t mem_pool_is_code(uint64_t addr)
+{
+    if (in_flat(addr))
+        return flat_code[(addr - DRAM_BASE) / ENTRY_SIZE];
+    L3Entry *l3_entry = l3_entry_lkup(addr);
+    return (l3_entry != NULL) ? l3_entry->code : 0;
+}
+
+void mem_pool_clear_code()
+{
+    memset(flat_code, 0, sizeof(flat_code));
+    for (uint32_t i = 0; i < L1_LEN; i++)
+    {
+        if (!l1_table[i].valid)
+            continue;
+        L2Entry *l2_table = l1_table[i].l2_table;
+        for (uint32_t j = 0; j < L2_LEN; j++)
+        {
+            if (!l2_table[j].valid)
+                continue;
+            for (uint32_t k = 0; k < L3_LEN; k++)
+                l2_table[j].l3_table[k].code = 0;
+        }
+    }
+}
+
+MemPoolMode mem_pool_init(MemPoolMode mode)
 {
     // 初始化第一级页表，内容为空
     for (uint32_t i = 0; i < L1_LEN; i++)
@@ -164,6 +239,47 @@ void mem_pool_init()
     mem_pool_size = 0;
     l2_table_size = 0;
     l3_table_size = 0;
+
+    flat_base = NULL;
+    map_base = NULL;
+    flat_size = 0;
+    memset(flat_code, 0, sizeof(flat_code));
+    if (mode == MEM_POOL_GUARD) {
+        // 先把整个地址空间预留为保护区，再打开DRAM的窗口
+        void *base = mmap(NULL, GUARD_SPAN, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base != MAP_FAILED &&
+            mprotect((uint8_t*)base + DRAM_BASE, DRAM_SIZE, PROT_READ | PROT_WRITE) != 0) {
+            munmap(base, GUARD_SPAN);
+            base = MAP_FAILED;
+        }
+        if (base != MAP_FAILED) {
+            map_base = (uint8_t*)base;
+            map_size = GUARD_SPAN;
+            flat_base = map_base + DRAM_BASE;
+            return mode;
+        }
+        printf("Warning! Cannot reserve the guarded guest address space, fall back to the flat DRAM\n");
+        mode = MEM_POOL_FLAT;
+    }
+    if (mode == MEM_POOL_FLAT) {
+        // 只预留地址空间，不占用物理内存和swap
+        void *base = mmap(NULL, DRAM_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) {
+            printf("Warning! Cannot reserve %u MB for the flat DRAM, fall back to the radix pool\n",DRAM_SIZE / MEM1MB);
+            return MEM_POOL_RADIX;
+        }
+        map_base = (uint8_t*)base;
+        map_size = DRAM_SIZE;
+        flat_base = map_base;
+    }
+    return mode;
+}
+
+uint8_t *mem_pool_guard_base()
+{
+    return (map_base != NULL && map_size == GUARD_SPAN) ? map_base : NULL;
 }
 
 void l3_table_free(L3Entry *l3_table){
@@ -199,15 +315,37 @@ void l1_table_free(){
     }
 }
 
+// 统计flat DRAM中已经分配了物理页的数量
+static uint64_t flat_resident(){
+    static uint8_t vec [DRAM_SIZE / MEM4KB];
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0)
+        return 0;
+    uint64_t host_page = (uint64_t)page_size;
+    uint64_t page_num = DRAM_SIZE / host_page;
+    if (page_num > sizeof(vec) || mincore(flat_base, DRAM_SIZE, vec) != 0)
+        return 0;
+    uint64_t num = 0;
+    for (uint64_t i = 0; i < page_num; i++)
+        num += vec[i] & 1;
+    return num * host_page / MEM1KB;
+}
+
 void mem_pool_free()
 {
     // 遍历内存池，销毁所有内存对象，并将所有表项清空
     l1_table_free();
+    if (flat_base != NULL) {
+        flat_size = flat_resident();
+        munmap(map_base, map_size);
+        flat_base = NULL;
+        map_base = NULL;
+    }
 }
 
 uint64_t get_mem_pool_size()
 {
-    return mem_pool_size * 4;
+    return mem_pool_size * 4 + ((flat_base != NULL) ? flat_resident() : flat_size);
 }
 
 uint64_t get_l2_table_size()
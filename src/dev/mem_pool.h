@@ -33,8 +33,28 @@
 
 #define ENTRY_SIZE 4096
 
-// 初始化内存池
-void mem_pool_init();
+// DRAM的后端
+//  MEM_POOL_RADIX：按页malloc，通过三级表查询
+//  MEM_POOL_FLAT：用一次mmap(MAP_NORESERVE)预留整个DRAM，地址转换为基地址加偏移，
+//                 页在第一次访问时由操作系统分配并清零
+//  MEM_POOL_GUARD：与MEM_POOL_FLAT相同，但是预留整个32位guest地址空间，DRAM以外都是PROT_NONE的保护区，
+//                  guest地址加上保护区的基地址就是host地址，越界的访问由SIGSEGV捕获，见memory.h
+// 所有后端中，DRAM以外的地址都使用三级表
+typedef enum {
+    MEM_POOL_RADIX = 0,
+    MEM_POOL_FLAT  = 1,
+    MEM_POOL_GUARD = 2
+} MemPoolMode;
+
+// MEM_POOL_GUARD预留的地址空间，末尾多出一页，使最高地址处跨越4GB的访问也落在保护区中
+#define GUARD_SPAN (((uint64_t)1 << 32) + ENTRY_SIZE)
+
+// 初始化内存池，返回实际使用的后端
+// mmap失败时MEM_POOL_GUARD退回到MEM_POOL_FLAT，MEM_POOL_FLAT退回到MEM_POOL_RADIX
+MemPoolMode mem_pool_init(MemPoolMode mode);
+
+// MEM_POOL_GUARD时返回guest地址0对应的host地址，其他后端返回NULL
+uint8_t* mem_pool_guard_base();
 
 // 释放所有内存池
 void mem_pool_free();
@@ -43,7 +63,15 @@ void mem_pool_free();
 // 该地址对应的页面的首地址，地址一定为 ENTRY_SIZE
 uint8_t* mem_pool_lkup(uint64_t addr);
 
+// 标记addr所在的页中是否有已经翻译的代码，页不存在时忽略
+void mem_pool_set_code(uint64_t addr, uint8_t code);
+// addr所在的页中是否有已经翻译的代码，页不存在时返回0
+uint8_t mem_pool_is_code(uint64_t addr);
+// 清除所有页的代码标记
+void mem_pool_clear_code();
+
 // 返回当前内存池中有效的内存容量，单位KB
+// MEM_POOL_FLAT时为DRAM中已经由操作系统分配的页，加上三级表中的页
 uint64_t get_mem_pool_size();
 // 返回当前内存池中L2 table占用的内存数量，单位Byte
 uint64_t get_l2_table_size();
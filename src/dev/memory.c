@@ -27,9 +27,13 @@ SOFTWARE.
 // 2. 管理物理内存
 // -------------------------------------------------------------------------------
 
+#define _GNU_SOURCE // ucontext中的REG_RIP
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <signal.h>
+#include <ucontext.h>
 #include "memory.h"
 #include "mem_pool.h"
 #include "dev_config.h"
@@ -68,13 +72,100 @@ typedef struct mem_check
     MemDevID dev_target;
 } MCheck;
 
-void memory_init()
+TlbEntry tlb_rd [TLB_SIZE];
+TlbEntry tlb_wr [TLB_SIZE];
+TlbStat  tlb_stat;
+
+uint8_t  *guard_base;
+uint64_t guard_trap;
+
+MemWrHook mem_wr_hook;
+
+#ifdef GUARD_SUPPORT
+
+// 由链接器生成，指向guard_fixup段的首尾
+extern const GuardFixup __start_guard_fixup[] __attribute__((weak));
+extern const GuardFixup __stop_guard_fixup[] __attribute__((weak));
+
+// 安装之前的SIGSEGV处理，不是guard_rd()引起的错误交给它，memory_free()时恢复
+static struct sigaction guard_old;
+static int guard_installed;
+
+static void guard_handler(int sig, siginfo_t *info, void *ctx){
+    ucontext_t *uc = (ucontext_t*)ctx;
+    uint64_t ip = (uint64_t)uc->uc_mcontext.gregs[REG_RIP];
+    uint8_t *fault_addr = (uint8_t*)info->si_addr;
+    if (guard_base != NULL && fault_addr >= guard_base && fault_addr < guard_base + GUARD_SPAN) {
+        for (const GuardFixup *fix = __start_guard_fixup; fix < __stop_guard_fixup; fix++)
+        {
+            if (fix->ip == ip) {
+                uc->uc_mcontext.gregs[REG_RIP] = (greg_t)fix->trap;
+                guard_trap += 1;
+                return;
+            }
+        }
+    }
+    // 不是guard_rd()引起的错误，交给之前的处理函数
+    if ((guard_old.sa_flags & SA_SIGINFO) && guard_old.sa_sigaction != NULL) {
+        guard_old.sa_sigaction(sig,info,ctx);
+        return;
+    }
+    if (guard_old.sa_handler != SIG_DFL && guard_old.sa_handler != SIG_IGN) {
+        guard_old.sa_handler(sig);
+        return;
+    }
+    // 之前是默认处理，恢复之后返回，重新执行出错的指令时结束进程
+    sigaction(sig,&guard_old,NULL);
+}
+
+// 安装SIGSEGV的处理函数，失败时返回非0
+static int guard_init(){
+    struct sigaction act;
+    memset(&act,0,sizeof(act));
+    act.sa_sigaction = guard_handler;
+    act.sa_flags = SA_SIGINFO;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGSEGV,&act,&guard_old) != 0)
+        return 1;
+    guard_installed = 1;
+    return 0;
+}
+
+#endif // GUARD_SUPPORT
+
+MemPoolMode memory_init(MemPoolMode mode)
 {
-    mem_pool_init();
+    tlb_flush();
+    guard_base = NULL;
+    guard_trap = 0;
+#ifndef GUARD_SUPPORT
+    // 没有SIGSEGV到trap分支的跳转，只能使用普通的flat DRAM
+    if (mode == MEM_POOL_GUARD)
+        mode = MEM_POOL_FLAT;
+#endif
+    mode = mem_pool_init(mode);
+#ifdef GUARD_SUPPORT
+    if (mode == MEM_POOL_GUARD) {
+        if (guard_init() != 0) {
+            // 保护区的映射仍然有效，只是load不再使用guard_rd()
+            printf("Warning! Cannot install the SIGSEGV handler, guard pages are not used by loads\n");
+            return MEM_POOL_FLAT;
+        }
+        guard_base = mem_pool_guard_base();
+    }
+#endif
+    return mode;
 }
 
 void memory_free()
 {
+#ifdef GUARD_SUPPORT
+    if (guard_installed) {
+        sigaction(SIGSEGV,&guard_old,NULL);
+        guard_installed = 0;
+    }
+#endif
+    guard_base = NULL;
     mem_pool_free();
 }
 
@@ -171,44 +262,88 @@ static uint8_t *get_mem_ptr(uint64_t addr){
     return (mem_addr + offset);
 }
 
-// DRAM 读取
-static inline int read_dram(uint64_t addr,uint8_t *data_buf,MCheck mem_check){
-    uint8_t *rd_ptr = get_mem_ptr(addr);
-    assert(rd_ptr!=NULL);
-    for (uint8_t i = 0; i < mem_check.byte_num; i++)
+// 按宽度复制，byte_num为常量的memcpy编译为一次host的load/store
+static inline void dram_copy(uint8_t *dst, const uint8_t *src, uint8_t byte_num){
+    switch (byte_num)
     {
-        data_buf[i] = rd_ptr[i];
+    case 1: memcpy(dst,src,1); break;
+    case 2: memcpy(dst,src,2); break;
+    case 4: memcpy(dst,src,4); break;
+    case 8: memcpy(dst,src,8); break;
+    default: memcpy(dst,src,byte_num); break;
     }
+}
+
+// 跨页的访问分成两段，很少发生，不内联
+static __attribute__((noinline, cold)) int read_dram_across(uint64_t addr,uint8_t *data_buf,MCheck mem_check){
+    uint8_t *rd_ptr = get_mem_ptr(addr);
+    assert(rd_ptr!=NULL);
+    memcpy(data_buf,rd_ptr,mem_check.byte_num);
+    rd_ptr = get_mem_ptr(mem_check.next_page_addr);
+    assert(rd_ptr!=NULL);
+    memcpy(data_buf + mem_check.byte_num,rd_ptr,mem_check.across_offset);
+    return 0;
+}
 
+static __attribute__((noinline, cold)) int write_dram_across(uint64_t addr,uint8_t *data_buf,MCheck mem_check){
+    uint8_t *wr_ptr = get_mem_ptr(addr);
+    assert(wr_ptr!=NULL);
+    memcpy(wr_ptr,data_buf,mem_check.byte_num);
+    wr_ptr = get_mem_ptr(mem_check.next_page_addr);
+    assert(wr_ptr!=NULL);
+    memcpy(wr_ptr,data_buf + mem_check.byte_num,mem_check.across_offset);
+    return 0;
+}
+
+// DRAM 读取
+static inline int read_dram(uint64_t addr,uint8_t *data_buf,MCheck mem_check){
     if (mem_check.across_page)
-    {
-        rd_ptr = get_mem_ptr(mem_check.next_page_addr);
-        for (uint8_t i = 0; i < mem_check.across_offset; i++)
-        {
-            data_buf[mem_check.byte_num + i] = rd_ptr[i];
-        }
-    }
+        return read_dram_across(addr,data_buf,mem_check);
+    uint8_t *rd_ptr = get_mem_ptr(addr);
+    assert(rd_ptr!=NULL);
+    dram_copy(data_buf,rd_ptr,mem_check.byte_num);
     return 0;
 }
 
 // DRAM 写
 static inline int write_dram(uint64_t addr,uint8_t *data_buf,MCheck mem_check){
+    if (mem_check.across_page)
+        return write_dram_across(addr,data_buf,mem_check);
     uint8_t *wr_ptr = get_mem_ptr(addr);
     assert(wr_ptr!=NULL);
-    for (uint8_t i = 0; i < mem_check.byte_num; i++)
-    {
-        wr_ptr[i] = data_buf[i] ;
-    }
+    dram_copy(wr_ptr,data_buf,mem_check.byte_num);
+    return 0;
+}
 
-    if (mem_check.across_page)
+static inline void tlb_fill_rd(uint64_t addr){
+    TlbEntry *ent = &tlb_rd[tlb_idx(addr)];
+    ent->tag = ROUND(addr,ENTRY_SIZE);
+    ent->page = mem_pool_lkup(ent->tag);
+}
+
+void tlb_fill_wr(uint64_t addr)
+{
+    if (addr < DRAM_BASE || addr > DRAM_END || mem_pool_is_code(addr))
+        return;
+    TlbEntry *ent = &tlb_wr[tlb_idx(addr)];
+    ent->tag = ROUND(addr,ENTRY_SIZE);
+    ent->page = mem_pool_lkup(ent->tag);
+}
+
+void tlb_flush_wr(uint64_t addr)
+{
+    TlbEntry *ent = &tlb_wr[tlb_idx(addr)];
+    if (ent->tag == ROUND(addr,ENTRY_SIZE))
+        ent->tag = TLB_INVALID;
+}
+
+void tlb_flush()
+{
+    for (uint32_t i = 0; i < TLB_SIZE; i++)
     {
-        wr_ptr = get_mem_ptr(mem_check.next_page_addr);
-        for (uint8_t i = 0; i < mem_check.across_offset; i++)
-        {
-            wr_ptr[i] = data_buf[mem_check.byte_num + i];
-        }
+        tlb_rd[i].tag = TLB_INVALID;
+        tlb_wr[i].tag = TLB_INVALID;
     }
-    return 0;
 }
 
 int read_data(uint64_t addr, uint8_t byte_num, MemOpSrc op_src, uint8_t *data_buf)
@@ -228,6 +363,9 @@ int read_data(uint64_t addr, uint8_t byte_num, MemOpSrc op_src, uint8_t *data_bu
 
     // 总线 DeMux
     if (mem_check.dev_target == DRAM) {
+        // 后端访问的页填入读TLB，下一次访问不再经过地址检查和内存池的查询
+        if (op_src == CPU_BE)
+            tlb_fill_rd(addr);
         return read_dram(addr,data_buf,mem_check);
     }
     else if (mem_check.dev_target == KBD) {
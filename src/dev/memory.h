@@ -27,6 +27,9 @@ SOFTWARE.
     #define __MEMORY_H__
 
 #include <stdint.h>
+#include <string.h>
+#include "mem_pool.h"
+#include "../include/comm.h"
 
 typedef enum {
     CPU_FE  = 0, // Front End in CPU
@@ -41,7 +44,8 @@ typedef struct mem_port
     uint8_t  port_width; // Port的宽度（byte数）
 } MemPort;
 
-void memory_init();
+// mode为DRAM的后端，见mem_pool.h，返回实际使用的后端
+MemPoolMode memory_init(MemPoolMode mode);
 void memory_free();
 
 // 主存读操作
@@ -80,4 +84,206 @@ uint32_t get_lsu_fault();
 uint32_t get_mmu_fault();
 
 
+// ----------------------------------------------
+// 软件TLB
+// ----------------------------------------------
+// 直接映射，以guest页的地址为tag，缓存该页在内存池中的host地址，读和写分开
+// 只缓存DRAM的页，设备地址不会进入TLB，总是经过read_data()/write_data()
+// 写TLB只缓存没有已经译码或者翻译的代码的页，命中时不需要使译码缓存和基本块失效
+// 页中的代码被译码或者翻译时，需要调用tlb_flush_wr()
+#define TLB_SIZE    256 // 必须是2的幂
+#define TLB_INVALID (ENTRY_SIZE - 1) // 不对齐的tag，不会与任何页匹配，也不会与不对齐的访问匹配
+
+typedef struct tlb_entry_t
+{
+    uint64_t tag;   // guest页的地址
+    uint8_t *page;  // 内存池中的host地址
+} TlbEntry;
+
+typedef struct tlb_stat_t
+{
+    uint64_t rd_hit;
+    uint64_t rd_miss;
+    uint64_t wr_hit;
+    uint64_t wr_miss;
+} TlbStat;
+
+extern TlbEntry tlb_rd [TLB_SIZE];
+extern TlbEntry tlb_wr [TLB_SIZE];
+extern TlbStat  tlb_stat;
+
+static inline uint32_t tlb_idx(uint64_t addr){
+    return (uint32_t)((addr / ENTRY_SIZE) & (TLB_SIZE - 1));
+}
+
+// 对齐的访问不会跨页，把地址中不对齐的低位并入tag，只需要比较一次
+// byte_num必须是2的幂，不对齐的访问总是不命中
+static inline uint64_t tlb_key(uint64_t addr, uint8_t byte_num){
+    return ROUND(addr,ENTRY_SIZE) | MOD(addr,byte_num);
+}
+
+// 命中并且对齐时返回host地址，否则返回NULL，由调用者使用read_data()
+static inline uint8_t* tlb_rd_ptr(uint64_t addr, uint8_t byte_num){
+    TlbEntry *ent = &tlb_rd[tlb_idx(addr)];
+    if (ent->tag == tlb_key(addr,byte_num)) {
+        tlb_stat.rd_hit += 1;
+        return ent->page + MOD(addr,ENTRY_SIZE);
+    }
+    tlb_stat.rd_miss += 1;
+    return NULL;
+}
+
+// 与tlb_rd_ptr()相同，返回NULL时由调用者使用write_data()，并使译码缓存和基本块失效
+static inline uint8_t* tlb_wr_ptr(uint64_t addr, uint8_t byte_num){
+    TlbEntry *ent = &tlb_wr[tlb_idx(addr)];
+    if (ent->tag == tlb_key(addr,byte_num)) {
+        tlb_stat.wr_hit += 1;
+        return ent->page + MOD(addr,ENTRY_SIZE);
+    }
+    tlb_stat.wr_miss += 1;
+    return NULL;
+}
+
+// read_data()在CPU后端读DRAM时自动填入读TLB
+// 写TLB由调用者在确认页中没有已经译码的代码之后填入，页中有已经翻译的代码或者不是DRAM时忽略
+void tlb_fill_wr(uint64_t addr);
+
+// 从写TLB中移除addr所在的页
+void tlb_flush_wr(uint64_t addr);
+
+// 清空读和写TLB
+void tlb_flush();
+
+// ----------------------------------------------
+// 保护区
+// ----------------------------------------------
+// MEM_POOL_GUARD时，guest地址加上guard_base就是host地址，load不需要查TLB，也不需要检查边界和跨页
+// DRAM以外的地址都是PROT_NONE，包括设备的地址，load不做任何比较，访问设备时由SIGSEGV转到read_data()
+// 一次SIGSEGV需要经过内核，代价是几微秒，设备的load较多的程序应该使用flat
+// 每一个guard_rd()展开的host load指令都在guard_fixup段中登记一项，
+// SIGSEGV的处理函数按照出错的host指令地址查表，跳到对应的trap分支，由调用者使用read_data()
+// read_data()完成设备的访问，或者返回错误，由调用者产生guest的访问异常
+// store需要检查页中是否有已经翻译的代码，仍然经过写TLB
+#if defined(__x86_64__) && defined(__linux__) && !defined(RV64)
+    #define GUARD_SUPPORT
+#endif
+
+extern uint8_t  *guard_base; // 不是MEM_POOL_GUARD时为NULL
+extern uint64_t guard_trap;  // 被SIGSEGV捕获的访问数
+
+#ifdef GUARD_SUPPORT
+
+typedef struct guard_fixup_t
+{
+    uint64_t ip;    // 可能出错的host load指令
+    uint64_t trap;  // 出错后继续执行的地址
+} GuardFixup;
+
+#define GUARD_FIXUP                                 \
+    ".pushsection guard_fixup,\"aw\"\n\t"           \
+    ".balign 8\n\t"                                 \
+    ".quad 1b, %l[trap]\n\t"                        \
+    ".popsection"
+
+// 成功时返回0，访问了保护区时返回1，由调用者使用read_data()
+static inline int guard_rd(uint32_t addr, uint8_t byte_num, void *buf){
+    uint8_t *ptr = guard_base + addr;
+    uint32_t data;
+    switch (byte_num)
+    {
+    case 1:
+        asm goto ("1: movzbl %1, %0\n\t" GUARD_FIXUP
+                  : "=r"(data) : "m"(*(const uint8_t*)ptr) : : trap);
+        *(uint8_t*)buf = (uint8_t)data;
+        return 0;
+    case 2:
+        asm goto ("1: movzwl %1, %0\n\t" GUARD_FIXUP
+                  : "=r"(data) : "m"(*(const uint16_t*)ptr) : : trap);
+        *(uint16_t*)buf = (uint16_t)data;
+        return 0;
+    case 4:
+        asm goto ("1: movl %1, %0\n\t" GUARD_FIXUP
+                  : "=r"(data) : "m"(*(const uint32_t*)ptr) : : trap);
+        *(uint32_t*)buf = data;
+        return 0;
+    case 8:
+        {
+            uint64_t data64;
+            asm goto ("1: movq %1, %0\n\t" GUARD_FIXUP
+                      : "=r"(data64) : "m"(*(const uint64_t*)ptr) : : trap);
+            *(uint64_t*)buf = data64;
+        }
+        return 0;
+    default:
+        return 1;
+    }
+trap:
+    return 1;
+}
+
+#endif // GUARD_SUPPORT
+
+// ----------------------------------------------
+// 按宽度访问
+// ----------------------------------------------
+// 对齐并且命中TLB（或者MEM_POOL_GUARD时不在保护区）的访问编译为一次host的load/store
+// 不对齐、跨页和设备的访问经过read_data()/write_data()
+// 返回0表示成功，其他为read_data()/write_data()的错误码
+
+// 写操作没有命中写TLB，经过write_data()成功写入之后调用
+// 由CPU使译码缓存和基本块失效，并决定是否填入写TLB
+typedef void (*MemWrHook)(uint64_t addr, uint8_t byte_num);
+extern MemWrHook mem_wr_hook;
+
+static inline int mem_read(uint64_t addr, uint8_t byte_num, MemOpSrc op_src, void *buf){
+#ifdef GUARD_SUPPORT
+    if (guard_base != NULL)
+        return guard_rd(addr,byte_num,buf) ? read_data(addr,byte_num,op_src,(uint8_t*)buf) : 0;
+#endif
+    uint8_t *ptr = tlb_rd_ptr(addr,byte_num);
+    if (ptr != NULL) {
+        memcpy(buf,ptr,byte_num);
+        return 0;
+    }
+    return read_data(addr,byte_num,op_src,(uint8_t*)buf);
+}
+
+static inline int mem_write(uint64_t addr, uint8_t byte_num, MemOpSrc op_src, const void *buf){
+    uint8_t *ptr = tlb_wr_ptr(addr,byte_num);
+    if (ptr != NULL) {
+        memcpy(ptr,buf,byte_num);
+        return 0;
+    }
+    int res = write_data(addr,byte_num,op_src,(uint8_t*)buf);
+    if (res == 0 && mem_wr_hook != NULL)
+        mem_wr_hook(addr,byte_num);
+    return res;
+}
+
+static inline int mem_read_u8(uint64_t addr, MemOpSrc op_src, uint8_t *data){
+    return mem_read(addr,1,op_src,data);
+}
+static inline int mem_read_u16(uint64_t addr, MemOpSrc op_src, uint16_t *data){
+    return mem_read(addr,2,op_src,data);
+}
+static inline int mem_read_u32(uint64_t addr, MemOpSrc op_src, uint32_t *data){
+    return mem_read(addr,4,op_src,data);
+}
+static inline int mem_read_u64(uint64_t addr, MemOpSrc op_src, uint64_t *data){
+    return mem_read(addr,8,op_src,data);
+}
+
+static inline int mem_write_u8(uint64_t addr, MemOpSrc op_src, uint8_t data){
+    return mem_write(addr,1,op_src,&data);
+}
+static inline int mem_write_u16(uint64_t addr, MemOpSrc op_src, uint16_t data){
+    return mem_write(addr,2,op_src,&data);
+}
+static inline int mem_write_u32(uint64_t addr, MemOpSrc op_src, uint32_t data){
+    return mem_write(addr,4,op_src,&data);
+}
+static inline int mem_write_u64(uint64_t addr, MemOpSrc op_src, uint64_t data){
+    return mem_write(addr,8,op_src,&data);
+}
+
 #endif //__MEMORY_H__
\ No newline at end of file
@@ -31,6 +31,15 @@ SOFTWARE.
 #include <pthread.h>
 
 #include "cpu/cpu.h"
+#include "cpu/back_end.h"
+#include "cpu/dec_cache.h"
+#include "cpu/block_cache.h"
+#include "cpu/jit_x64.h"
+#include "cpu/aot.h"
+#include "cpu/disk_cache.h"
+#include "cpu/lockstep.h"
+#include "cpu/idiom.h"
+#include "cpu/hle.h"
 #include "dev/memory.h"
 #include "dev/display.h"
 #include "dev/dev_config.h"
@@ -52,6 +61,13 @@ void print_localtime(){
     printf("--------------------------------\n");
 }
 
+// 墙上时间，单位为ms
+static double wall_ms(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
 static uint64_t timeout_num = TIMEOUT; // 默认值为TIMEOUT
 
 static uint8_t self_test = 0;
@@ -67,8 +83,37 @@ static uint8_t tracepc = 0;
 static char* tracepc_logfile;
 static FILE* tpc_fd = NULL;
 
+static uint8_t instrument = 0; // 逐条检查x0等不变量
+
+static uint64_t lockstep = 0;  // lockstep比较间隔，0表示关闭
+
+static uint8_t hle = 0;        // 由host执行ELF中的常用库函数
+
 static uint8_t non_func = 0;
 
+static uint8_t dec_cache = 1; // 默认使能译码缓存
+
+static ExeEngine engine = ENGINE_INTERP;
+
+static MemPoolMode mem_mode = MEM_POOL_RADIX; // DRAM的后端
+static const char *mem_mode_name[] = {"radix","flat","guard"};
+
+static uint32_t jit_hot     = JIT_HOT;     // 进入JIT baseline层的执行次数
+static uint32_t jit_opt_hot = JIT_OPT_HOT; // 进入JIT优化层的执行次数
+static uint32_t jit_threads = 0;           // JIT后台编译线程数
+
+static uint32_t predecode_threads = 0;     // 加载后预译码的线程数，0表示不预译码
+
+static uint8_t aot_gen_mode = 0; // 只生成AOT的C文件，不执行
+static char* aot_gen_file;
+
+static uint8_t aot = 0;
+static char* aot_file;
+
+static uint8_t disk_cache = 0;
+static char* disk_cache_dir;
+static uint64_t disk_cache_cap = DISK_CACHE_CAP;
+
 // 线程控制
 static uint8_t cpu_exit;
 static uint8_t dev_exit;
@@ -87,12 +132,36 @@ int arguments_parse(int argc, char* argv[]){
     // bootloader： bootloader的二进制文件
     // resetpc： reset时的PC，注意如果指定了-s选项，则不应该给出reset_addr
     // tracepc： trace开关，打开时需要给出trace log文件的路径
+    // nodeccache： 关闭译码缓存，每条指令都重新取指和译码
+    // engine： 选择执行引擎，interp，threaded，block 或 jit
+    // jithot： JIT各层的阈值，格式为 baseline[,opt]
+    // aotgen： 对-s或者--bootloader给出的ELF进行静态重编译，生成C文件后退出
+    // aot： 加载由aotgen生成的C文件编译得到的动态库
+    // diskcache： 译码缓存的磁盘目录，格式为 dir[,MB]
+    // jitthreads： JIT后台编译线程数
+    // predecode： 加载后使用N个线程对可执行段进行预译码
+    // instrument： 使用插桩的执行循环，逐条检查x0等不变量
+    // lockstep： 与interp引擎的参考进程差分执行，每N条指令或者每个基本块比较一次状态
+    // hle： 根据ELF的符号表，由host执行memcpy等常用库函数和软件浮点函数
+    // dram： DRAM的后端，radix、flat 或 guard
     // help：帮助
     const struct option longopts[] =
     {
       {"bootloader",    required_argument,      &optflags,  1},
       {"resetpc",       required_argument,      &optflags,  2},
       {"tracepc",       required_argument,      &optflags,  3},
+      {"nodeccache",    no_argument,            &optflags,  4},
+      {"engine",        required_argument,      &optflags,  5},
+      {"jithot",        required_argument,      &optflags,  6},
+      {"aotgen",        required_argument,      &optflags,  7},
+      {"aot",           required_argument,      &optflags,  8},
+      {"diskcache",     required_argument,      &optflags,  9},
+      {"jitthreads",    required_argument,      &optflags,  10},
+      {"predecode",     required_argument,      &optflags,  11},
+      {"instrument",    no_argument,            &optflags,  12},
+      {"lockstep",      required_argument,      &optflags,  13},
+      {"hle",           no_argument,            &optflags,  14},
+      {"dram",          required_argument,      &optflags,  15},
       {"help",          no_argument,            0,          'h'},
       {"version",       no_argument,            0,          'v'},
       {0,0,0,0},
@@ -117,6 +186,18 @@ int arguments_parse(int argc, char* argv[]){
             printf("    --bootloader    filepath        filepath of the bootloader program\n");
             printf("    --resetpc       RESET_ADDR      integer, set the entry point of the Reset Vector\n");
             printf("    --tracepc       logfile         enable the function of PC tracing and Set the Log Filepath\n");
+            printf("    --nodeccache                    disable the decoded instruction cache\n");
+            printf("    --engine        name            execution engine: interp (default), threaded, block or jit\n");
+            printf("    --jithot        N1[,N2]         integer, block executions before the baseline (N1) and optimizing (N2) JIT tiers\n");
+            printf("    --aotgen        filepath        statically recompile the ELF given by -s or --bootloader into a C file and exit\n");
+            printf("    --aot           filepath        load the shared library compiled from the --aotgen output\n");
+            printf("    --diskcache     dir[,MB]        persist decoded pages in dir across runs, size capped at MB (default 64)\n");
+            printf("    --jitthreads    N               integer, number of background JIT compile threads (default 0, compile on the CPU thread)\n");
+            printf("    --predecode     N               integer, predecode the executable segments with N threads right after loading\n");
+            printf("    --instrument                    check invariants such as x0 after every instruction (interp engine only)\n");
+            printf("    --lockstep      N|block         self-test only, run an interp reference side by side and compare the state every N instructions or every block\n");
+            printf("    --hle                           run well-known library and soft-float functions found in the ELF symbol table on the host\n");
+            printf("    --dram          name            guest DRAM backend: radix (default), flat, or guard (no bounds check on loads, device loads trap)\n");
             printf("    --version                       display the version information.\n");
             printf("    --help                          display this help and exit\n");
             printf("\n<github: https://github.com/jackkyyang/VRiscV>\n");
@@ -157,6 +238,105 @@ int arguments_parse(int argc, char* argv[]){
                 tracepc = 1;
                 tracepc_logfile = str_copy(optarg);
             }
+            else if (optflags == 4) // 关闭译码缓存
+            {
+                dec_cache = 0;
+            }
+            else if (optflags == 5) // 选择执行引擎
+            {
+                if (strcmp(optarg,"interp") == 0)
+                    engine = ENGINE_INTERP;
+                else if (strcmp(optarg,"threaded") == 0)
+                    engine = ENGINE_THREADED;
+                else if (strcmp(optarg,"block") == 0)
+                    engine = ENGINE_BLOCK;
+                else if (strcmp(optarg,"jit") == 0)
+                    engine = ENGINE_JIT;
+                else
+                    printf("Warning! Unknown engine: %s, use interp\n",optarg);
+            }
+            else if (optflags == 6) // JIT各层的阈值
+            {
+                jit_hot = (uint32_t)strtoul(optarg,&endptr,0);
+                if (*endptr == ',')
+                    jit_opt_hot = (uint32_t)strtoul(endptr + 1,&endptr,0);
+                if (*endptr != '\0'){
+                    printf("Bad JIT Threshold Option Content: %s\n",optarg);
+                    jit_hot     = JIT_HOT;
+                    jit_opt_hot = JIT_OPT_HOT;
+                }
+            }
+            else if (optflags == 7) // 生成AOT代码
+            {
+                aot_gen_mode = 1;
+                aot_gen_file = str_copy(optarg);
+            }
+            else if (optflags == 8) // 加载AOT代码
+            {
+                aot = 1;
+                aot_file = str_copy(optarg);
+            }
+            else if (optflags == 9) // 译码缓存的磁盘目录
+            {
+                disk_cache = 1;
+                disk_cache_dir = str_copy(optarg);
+                char *sep = strchr(disk_cache_dir,',');
+                if (sep != NULL) {
+                    *sep = '\0';
+                    disk_cache_cap = strtoull(sep + 1,&endptr,0) * 1024 * 1024;
+                    if (*endptr != '\0' || disk_cache_cap == 0) {
+                        printf("Bad Disk Cache Option Content: %s\n",optarg);
+                        disk_cache_cap = DISK_CACHE_CAP;
+                    }
+                }
+            }
+            else if (optflags == 10) // JIT后台编译线程数
+            {
+                jit_threads = (uint32_t)strtoul(optarg,&endptr,0);
+                if (*endptr != '\0' || jit_threads > JIT_MAX_THREADS){
+                    printf("Bad JIT Thread Option Content: %s\n",optarg);
+                    jit_threads = 0;
+                }
+            }
+            else if (optflags == 11) // 预译码线程数
+            {
+                predecode_threads = (uint32_t)strtoul(optarg,&endptr,0);
+                if (*endptr != '\0'){
+                    printf("Bad Predecode Option Content: %s\n",optarg);
+                    predecode_threads = 0;
+                }
+            }
+            else if (optflags == 12) // 插桩运行
+            {
+                instrument = 1;
+            }
+            else if (optflags == 13) // lockstep差分执行
+            {
+                if (strcmp(optarg,"block") == 0)
+                    lockstep = LOCKSTEP_BLOCK;
+                else {
+                    lockstep = strtoull(optarg,&endptr,0);
+                    if (*endptr != '\0' || lockstep == 0){
+                        printf("Bad Lockstep Option Content: %s\n",optarg);
+                        lockstep = 0;
+                    }
+                }
+            }
+            else if (optflags == 14) // 高层模拟库函数
+            {
+                hle = 1;
+            }
+            else if (optflags == 15) // DRAM的后端
+            {
+                if (strcmp(optarg,"radix") == 0)
+                    mem_mode = MEM_POOL_RADIX;
+                else if (strcmp(optarg,"flat") == 0)
+                    mem_mode = MEM_POOL_FLAT;
+                else if (strcmp(optarg,"guard") == 0)
+                    mem_mode = MEM_POOL_GUARD;
+                else
+                    printf("Warning! Unknown DRAM backend: %s, use radix\n",optarg);
+            }
 
             break;
 
@@ -179,6 +359,55 @@ int arguments_parse(int argc, char* argv[]){
     if (self_test == 1 && bootloader == 1)
         printf("Warning! The Bootloader setted by user will be covered by address found in self-test file\n");
 
+    if (engine != ENGINE_INTERP && tracepc == 1)
+        printf("Warning! PC tracing only works with the interp engine, the engine setted by user will be ignored\n");
+
+    if (engine != ENGINE_INTERP && instrument == 1)
+        printf("Warning! Instrumented execution only works with the interp engine, the engine setted by user will be ignored\n");
+
+    // 参考进程不能与设备线程共享guest状态，只在自测模式下使用lockstep
+    if (lockstep != 0 && self_test == 0) {
+        printf("Warning! Lockstep only works in self-test mode, --lockstep is ignored\n");
+        lockstep = 0;
+    }
+
+    if (lockstep != 0 && (tracepc == 1 || instrument == 1)) {
+        printf("Warning! Lockstep cannot be combined with PC tracing or instrumented execution, --lockstep is ignored\n");
+        lockstep = 0;
+    }
+
+    // 参考进程逐条执行guest的库函数，HLE改变了临时寄存器和instret，状态无法比较
+    if (hle == 1 && lockstep != 0) {
+        printf("Warning! HLE changes the architectural state seen by the lockstep reference, --hle is ignored\n");
+        hle = 0;
+    }
+
+    if (hle == 1 && self_test == 0 && bootloader == 0) {
+        printf("Warning! HLE needs the symbol table of an ELF given by -s or --bootloader, --hle is ignored\n");
+        hle = 0;
+    }
+
+    // interp以外的执行引擎都依赖译码缓存
+    if (engine != ENGINE_INTERP && dec_cache == 0) {
+        printf("Warning! Execution engines other than interp require the decoded instruction cache, --nodeccache is ignored\n");
+        dec_cache = 1;
+    }
+
+    if (predecode_threads > 0 && dec_cache == 0) {
+        printf("Warning! Predecoding fills the decoded instruction cache, --predecode is ignored with --nodeccache\n");
+        predecode_threads = 0;
+    }
+
+    if (disk_cache == 1 && dec_cache == 0)
+        printf("Warning! The disk cache stores the decoded instruction cache, --diskcache is ignored with --nodeccache\n");
+
+    // AOT代码以基本块为单位绑定，需要block或者jit引擎
+    if (aot == 1 && (engine == ENGINE_INTERP || engine == ENGINE_THREADED) && tracepc == 0 && instrument == 0) {
+        printf("Warning! AOT code requires the block or jit engine, use block\n");
+        engine = ENGINE_BLOCK;
+        dec_cache = 1;
+    }
+
 
 }
 
@@ -218,12 +447,88 @@ static void prinf_runtime_info(){
     printf("%lu Instructions Simulated!\n",inst_num);
     printf("Time Cost: %f\n",time_cost);
     printf("Instruction Number Per Second: %f\n",ips);
+    if (dec_cache) {
+        DecCacheStat *dc_stat = get_dec_cache_stat();
+        uint64_t dc_total = dc_stat->hit + dc_stat->miss;
+        double dc_hit_rate = dc_total ? (double)(dc_stat->hit) * 100 / dc_total : 0;
+        printf("Decode Cache Hit: %lu, Miss: %lu, Hit Rate: %.2f%%\n",dc_stat->hit,dc_stat->miss,dc_hit_rate);
+        printf("Decode Cache Invalidation: %lu, Eviction: %lu\n",dc_stat->inval,dc_stat->evict);
+    }
+    printf("Guest Memory: %lu KB, Backend: %s\n",get_mem_pool_size(),mem_mode_name[mem_mode]);
+    if (mem_mode == MEM_POOL_GUARD)
+        printf("Guard Page Trap: %lu\n",guard_trap);
+    uint64_t tlb_rd_all = tlb_stat.rd_hit + tlb_stat.rd_miss;
+    uint64_t tlb_wr_all = tlb_stat.wr_hit + tlb_stat.wr_miss;
+    printf("TLB Read Hit: %lu, Miss: %lu, Hit Rate: %.2f%%\n",tlb_stat.rd_hit,tlb_stat.rd_miss,
+           tlb_rd_all ? (double)(tlb_stat.rd_hit) * 100 / tlb_rd_all : 0);
+    printf("TLB Write Hit: %lu, Miss: %lu, Hit Rate: %.2f%%\n",tlb_stat.wr_hit,tlb_stat.wr_miss,
+           tlb_wr_all ? (double)(tlb_stat.wr_hit) * 100 / tlb_wr_all : 0);
+    if (engine != ENGINE_INTERP && tracepc == 0) {
+        printf("Fused Pair Decoded: %lu, Fused Op Executed: %lu\n",get_dec_cache_stat()->fuse,get_fuse_cnt());
+    }
+    if ((engine == ENGINE_BLOCK || engine == ENGINE_JIT) && tracepc == 0) {
+        BlkCacheStat *bc_stat = get_blk_cache_stat();
+        printf("Block Translated: %lu, Chained: %lu, Flush: %lu\n",bc_stat->translate,bc_stat->chain,bc_stat->flush);
+        printf("Block Invalidated: %lu, Fence.i: %lu\n",bc_stat->inval,bc_stat->fence);
+        uint64_t ras_all  = bc_stat->ras_hit + bc_stat->ras_miss;
+        uint64_t ibtc_all = bc_stat->ibtc_hit + bc_stat->ibtc_miss;
+        printf("Return Stack Hit: %lu, Miss: %lu, Hit Rate: %.2f%%\n",bc_stat->ras_hit,bc_stat->ras_miss,
+               ras_all ? (double)(bc_stat->ras_hit) * 100 / ras_all : 0);
+        printf("Indirect Target Cache Hit: %lu, Miss: %lu, Hit Rate: %.2f%%\n",bc_stat->ibtc_hit,bc_stat->ibtc_miss,
+               ibtc_all ? (double)(bc_stat->ibtc_hit) * 100 / ibtc_all : 0);
+        IdiomStat *im_stat = get_idiom_stat();
+        printf("Loop Idiom Recognized: %lu, Executed: %lu, Fallback: %lu, Instructions: %lu\n",
+               im_stat->match,im_stat->exec,im_stat->fallback,im_stat->inst);
+    }
+    if (hle) {
+        HleStat *hle_stat = get_hle_stat();
+        printf("HLE Hooks: %lu, Calls: %lu, Fallback: %lu\n",hle_stat->hook,hle_stat->call,hle_stat->fallback);
+    }
+    if (engine == ENGINE_JIT && tracepc == 0) {
+        JitStat *jit_stat = get_jit_stat();
+        printf("JIT Threshold Baseline: %u, Optimizing: %u\n",jit_hot,jit_opt_hot);
+        printf("JIT Tier Up Baseline: %lu, Optimizing: %lu, Failed: %lu\n",
+               jit_stat->compile[JIT_TIER_BASE],jit_stat->compile[JIT_TIER_OPT],jit_stat->fail);
+        printf("JIT Compiled Instruction Baseline: %lu, Optimizing: %lu\n",
+               jit_stat->inst[JIT_TIER_BASE],jit_stat->inst[JIT_TIER_OPT]);
+        printf("JIT Compile Time Baseline: %.3f ms, Optimizing: %.3f ms\n",
+               (double)(jit_stat->compile_ns[JIT_TIER_BASE]) / 1e6,(double)(jit_stat->compile_ns[JIT_TIER_OPT]) / 1e6);
+        printf("JIT Constant Folded: %lu, Dead Write: %lu, Host Register: %lu\n",
+               jit_stat->const_fold,jit_stat->dead_write,jit_stat->host_reg);
+        printf("JIT Code Size: %lu Bytes, Cache Full: %lu\n",jit_stat->code_size,jit_stat->full);
+        if (jit_stat->thread > 0)
+            printf("JIT Background Thread: %lu, Request: %lu, Speculative: %lu, Discarded: %lu\n",
+                   jit_stat->thread,jit_stat->async,jit_stat->spec,jit_stat->discard);
+        BlkCacheStat *tr_stat = get_blk_cache_stat();
+        double coverage = inst_num ? (double)(tr_stat->trace_inst) * 100 / inst_num : 0;
+        printf("Superblock Built: %lu, Blocks: %lu, Side Exit: %lu\n",tr_stat->trace,tr_stat->trace_blk,tr_stat->trace_exit);
+        printf("Trace Coverage: %.2f%% (%lu Instructions)\n",coverage,tr_stat->trace_inst);
+    }
+    if (disk_cache && dec_cache) {
+        DiskCacheStat *dk_stat = get_disk_cache_stat();
+        printf("Disk Cache Page Hit: %lu, Miss: %lu, Stored: %lu, Evicted: %lu\n",
+               dk_stat->hit,dk_stat->miss,dk_stat->store,dk_stat->evict);
+    }
+    if (aot && tracepc == 0) {
+        AotStat *aot_stat = get_aot_stat();
+        printf("AOT Function: %lu, Bound: %lu, Stale: %lu, Miss: %lu\n",
+               aot_stat->func,aot_stat->bound,aot_stat->stale,aot_stat->miss);
+    }
     printf("--------------------------------\n");
 }
 
 // 资源释放
 static void resource_free(){
     memory_free(); // 对应 memory_init()
+    dec_cache_free();
+    blk_cache_free();
+    jit_free();
+    aot_free();
+    if (aot)
+        free((void*)aot_file);
+    disk_cache_free();
+    if (disk_cache)
+        free((void*)disk_cache_dir);
     if (self_test)
         free((void*)self_test_file);
     if (bootloader)
@@ -276,6 +581,14 @@ int main(int argc, char* argv[]){
         return 0;
     }
 
+    if (aot_gen_mode) {
+        char *elf_file = self_test ? self_test_file : bootloader_file;
+        if (aot_gen(elf_file,aot_gen_file) == 0)
+            printf("Build with: gcc -O2 -shared -fPIC -o <lib>.so %s, then run with --aot <lib>.so\n",aot_gen_file);
+        free((void*)aot_gen_file);
+        return 0;
+    }
+
 
     print_localtime();
     // 自测时也要初始化中断控制器，因此需要初始化中断锁
@@ -362,7 +675,9 @@ int main(int argc, char* argv[]){
     }
 
     // 初始化主存，必须在load 自测文件之前
-    memory_init();
+    mem_mode = memory_init(mem_mode);
+    dec_cache_init(dec_cache);
+    double load_start = wall_ms();
     if (self_test){
         // 必须在初始化memory之后才能加载可执行文件
         entry_addr = simple_loader(self_test_file);
@@ -375,12 +690,37 @@ int main(int argc, char* argv[]){
     {
         entry_addr = simple_loader(bootloader_file);
     }
+    if (entry_addr != ERR_ADDR)
+        printf("ELF Load Time: %.3f ms\n",wall_ms() - load_start);
 
+    // 注册符号表中可以由host执行的函数
+    if (hle && entry_addr != ERR_ADDR) {
+        uint32_t hook_num = read_func_sym(self_test ? self_test_file : bootloader_file,hle_add);
+        printf("HLE Hooks: %u\n",hook_num);
+    }
 
     if (entry_addr == ERR_ADDR) {
         init_err_flag = 2;
     }
 
+    if (disk_cache && dec_cache && init_err_flag == 0 && disk_cache_init(disk_cache_dir,disk_cache_cap) != 0)
+        printf("Warning! Disk cache is not available, continue without it\n");
+
+    // 多线程预译码可执行段，磁盘缓存需要在此之前初始化，预译码的页才能保存
+    if (predecode_threads > 0 && entry_addr != ERR_ADDR) {
+        uint64_t seg_base[LOADER_MAX_SEG];
+        uint64_t seg_size[LOADER_MAX_SEG];
+        uint32_t seg_num = get_exec_seg(seg_base,seg_size);
+        double pre_start = wall_ms();
+        uint32_t page_num = dec_cache_preload(seg_base,seg_size,seg_num,predecode_threads);
+        printf("Predecode Time: %.3f ms, Threads: %u, Pages: %u, Skipped: %lu\n",
+               wall_ms() - pre_start,predecode_threads,page_num,get_dec_cache_stat()->preload_skip);
+    }
+
+    // 加载AOT代码，失败时所有基本块仍然由执行引擎执行
+    if (aot && init_err_flag == 0 && aot_load(aot_file) != 0)
+        printf("Warning! AOT library is not loaded, continue without it\n");
+
     // ----------------------------
     // 进入CPU
     // ----------------------------
@@ -392,7 +732,13 @@ int main(int argc, char* argv[]){
         cpu_params.TIME_OUT = timeout_num;
         cpu_params.entry_addr = entry_addr;
         cpu_params.self_test = self_test;
+        cpu_params.engine = engine;
+        cpu_params.jit_hot = jit_hot;
+        cpu_params.jit_opt_hot = jit_opt_hot;
+        cpu_params.jit_threads = jit_threads;
         cpu_params.tpc_fd = tpc_fd;
+        cpu_params.instrument = instrument;
+        cpu_params.lockstep = lockstep;
         cpu_params.cpu_exit = &cpu_exit;
         cpu_params.start_time = &begin;
         cpu_params.end_time = &end;
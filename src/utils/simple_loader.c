@@ -39,11 +39,17 @@ SOFTWARE.
 #include <sys/mman.h>
 #include <sys/stat.h>
 
+#include "simple_loader.h"
 #include "../dev/mem_pool.h"
 #include "../include/comm.h"
 
 #define STK_SZ           (1 << 20)
 
+// 最近一次加载的可执行段
+static uint64_t exec_seg_base [LOADER_MAX_SEG];
+static uint64_t exec_seg_size [LOADER_MAX_SEG];
+static uint32_t exec_seg_num = 0;
+
 
 uint64_t simple_loader(const char *file) {
 
@@ -100,6 +106,7 @@ uint64_t simple_loader(const char *file) {
   }
 
   entry_addr= (uint64_t) h->e_entry;// 获取程序起始地址
+  exec_seg_num = 0;
   // 根据 Program header table file offset，拿到program header table的地址
   // 其中(char *)是为因为offset的单位是字节
   Elf32_Phdr *pht = (Elf32_Phdr *)((char *)h + h->e_phoff);
@@ -107,6 +114,12 @@ uint64_t simple_loader(const char *file) {
     // 取第i个propgram header
     Elf32_Phdr *p = &pht[i];
     if (p->p_type == PT_LOAD) {
+      // 记录可执行段，bss部分不会包含代码
+      if ((p->p_flags & PF_X) && p->p_filesz > 0 && exec_seg_num < LOADER_MAX_SEG) {
+        exec_seg_base[exec_seg_num] = p->p_vaddr;
+        exec_seg_size[exec_seg_num] = p->p_filesz;
+        exec_seg_num += 1;
+      }
       // 将ELF中的内容搬运到内存池中
       assert(p->p_align <= ENTRY_SIZE); // 程序的对齐要求必须小于内存池的最小尺寸
       uint64_t mapped_size = 0; // 已经map的数据量
@@ -184,3 +197,60 @@ uint64_t simple_loader(const char *file) {
   return entry_addr;
 
 }
+
+uint32_t get_exec_seg(uint64_t *base, uint64_t *size) {
+  for (uint32_t i = 0; i < exec_seg_num; i++) {
+    base[i] = exec_seg_base[i];
+    size[i] = exec_seg_size[i];
+  }
+  return exec_seg_num;
+}
+
+uint32_t read_func_sym(const char *file, int (*func)(const char *name, uint64_t addr)) {
+  struct stat statbuf;
+  if (stat(file,&statbuf) != 0 || statbuf.st_size < (long)sizeof(Elf32_Ehdr))
+    return 0;
+  size_t elf_size = (size_t)statbuf.st_size;
+  int fd = open(file, O_RDONLY);
+  if (fd == -1)
+    return 0;
+  uint8_t *elf = mmap(NULL, elf_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (elf == MAP_FAILED)
+    return 0;
+
+  uint32_t num = 0;
+  Elf32_Ehdr *h = (Elf32_Ehdr *)elf;
+  // 节头表和其中引用的内容都需要在文件范围之内
+  if (h->e_shoff == 0 || h->e_shentsize != sizeof(Elf32_Shdr) ||
+      (uint64_t)h->e_shoff + (uint64_t)h->e_shnum * sizeof(Elf32_Shdr) > elf_size) {
+    munmap(elf, elf_size);
+    return 0;
+  }
+  Elf32_Shdr *sht = (Elf32_Shdr *)(elf + h->e_shoff);
+  for (int i = 0; i < h->e_shnum; i++) {
+    Elf32_Shdr *s = &sht[i];
+    if (s->sh_type != SHT_SYMTAB || s->sh_link >= h->e_shnum)
+      continue;
+    // 符号的名字在sh_link指向的字符串表中
+    Elf32_Shdr *str = &sht[s->sh_link];
+    if ((uint64_t)s->sh_offset + s->sh_size > elf_size ||
+        (uint64_t)str->sh_offset + str->sh_size > elf_size || str->sh_size == 0)
+      continue;
+    Elf32_Sym *sym = (Elf32_Sym *)(elf + s->sh_offset);
+    const char *strtab = (const char *)(elf + str->sh_offset);
+    uint32_t sym_num = s->sh_size / sizeof(Elf32_Sym);
+    for (uint32_t j = 0; j < sym_num; j++) {
+      uint8_t bind = ELF32_ST_BIND(sym[j].st_info);
+      if (ELF32_ST_TYPE(sym[j].st_info) != STT_FUNC || sym[j].st_shndx == SHN_UNDEF ||
+          (bind != STB_GLOBAL && bind != STB_WEAK))
+        continue;
+      if (sym[j].st_name >= str->sh_size || memchr(strtab + sym[j].st_name, 0, str->sh_size - sym[j].st_name) == NULL)
+        continue;
+      if (func(strtab + sym[j].st_name, (uint64_t)sym[j].st_value))
+        num += 1;
+    }
+  }
+  munmap(elf, elf_size);
+  return num;
+}
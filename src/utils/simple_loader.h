@@ -25,9 +25,21 @@ SOFTWARE.
 #ifndef __SIMPLE_LOADER_H__
     #define __SIMPLE_LOADER_H__
 
+#include <stdint.h>
+
 // 简单的程序加载器，用于bring-up和调试
 // 输入为可执行的ELF文件路径
 // 输出为程序的入口
 uint64_t simple_loader(const char *file);
 
+#define LOADER_MAX_SEG 16 // 记录的可执行段的最大数量
+
+// 最近一次加载的可执行段（PT_LOAD且有PF_X标记）的地址和文件中的长度
+// base和size至少需要LOADER_MAX_SEG项，返回段的数量
+uint32_t get_exec_seg(uint64_t *base, uint64_t *size);
+
+// 读取ELF的.symtab，对每个全局或者弱定义的函数符号调用func(名字, 地址)
+// 返回func返回非0的次数，没有符号表或者不能读取时返回0
+uint32_t read_func_sym(const char *file, int (*func)(const char *name, uint64_t addr));
+
 #endif //__SIMPLE_LOADER_H__
\ No newline at end of file
@@ -0,0 +1,65 @@
+#!/bin/sh
+# 在各个执行引擎和配置下运行idiom_hle，见idiom_hle.S
+# 用法：run_test.sh path/to/VRiscV
+# 每个配置都必须通过自测，结果与interp引擎逐条执行相同
+# block引擎还必须实际识别出循环，--hle时必须实际由host完成调用，并且都有由guest代码逐条执行的情况
+# --lockstep时--hle被忽略，HLE只能通过结果的比较检查
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 path/to/VRiscV"
+    exit 2
+fi
+
+VRISCV=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+CASE=$(cd "$(dirname "$0")" && pwd)/idiom_hle
+# 自测结果写在当前目录的self_test_result.log中
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 2
+
+fail=0
+
+# run NAME ARGS...
+run() {
+    name=$1
+    shift
+    echo 0 > self_test_result.log
+    "$VRISCV" -s "$CASE" -t 100000000 "$@" > "$name.log" 2>&1
+    if [ "$(cat self_test_result.log)" = "1" ]; then
+        echo "PASS: $name"
+    else
+        echo "FAIL: $name ($*)"
+        fail=1
+    fi
+}
+
+# expect NAME REGEX：NAME的输出中需要有匹配的统计
+expect() {
+    if ! grep -Eq "$2" "$1.log"; then
+        echo "FAIL: $1, no match for '$2'"
+        fail=1
+    fi
+}
+
+IDIOM='Loop Idiom Recognized: [1-9][0-9]*, Executed: [1-9][0-9]*, Fallback: [1-9]'
+HLE='HLE Hooks: [1-9][0-9]*, Calls: [1-9][0-9]*, Fallback: [1-9]'
+
+run interp      --engine interp
+run threaded    --engine threaded
+run block       --engine block
+run jit         --engine jit --jithot 1
+run lockstep    --engine block --lockstep block
+run guard       --engine block --dram guard
+run hle_interp  --engine interp --hle
+run hle_thread  --engine threaded --hle
+run hle_block   --engine block --hle
+run hle_jit     --engine jit --jithot 1 --hle
+run hle_guard   --engine block --dram guard --hle
+expect block    "$IDIOM"
+expect jit      "$IDIOM"
+expect lockstep "$IDIOM"
+for name in hle_interp hle_thread hle_block hle_jit hle_guard; do
+    expect $name "$HLE"
+done
+
+exit $fail